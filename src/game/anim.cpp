@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "game/art.h"
+#include "game/cbench.h"
 #include "game/combat.h"
 #include "game/combat_defs.h"
 #include "game/combatai.h"
@@ -13,6 +14,8 @@
 #include "game/gconfig.h"
 #include "game/gmouse.h"
 #include "game/gsound.h"
+#include "game/flow.h"
+#include "game/hpath.h"
 #include "game/intface.h"
 #include "game/item.h"
 #include "game/map.h"
@@ -29,6 +32,7 @@
 #include "plib/color/color.h"
 #include "plib/gnw/debug.h"
 #include "plib/gnw/input.h"
+#include "plib/gnw/profile.h"
 #include "plib/gnw/rect.h"
 #include "plib/gnw/svga.h"
 #include "plib/gnw/vcr.h"
@@ -223,6 +227,9 @@ typedef struct PathNode {
     int rotation;
     int field_C;
     int field_10;
+
+    // CE: Index in the original flat open list (see `path_node_less`).
+    int slot;
 } PathNode;
 
 // TODO: I don't know what `sad` means, but it's definitely better than
@@ -256,11 +263,15 @@ static void anim_cleanup();
 static int anim_set_check(int a1);
 static int anim_set_continue(int a1, int a2);
 static int anim_set_end(int a1);
-static bool anim_can_use_door(Object* critter, Object* door);
 static int anim_move_to_object(Object* from, Object* to, int a3, int anim, int animationSequenceIndex);
 static int make_stair_path(Object* object, int from, int fromElevation, int to, int toElevation, StraightPathNode* a6, Object** obstaclePtr);
+static inline bool path_node_less(const PathNode* a, const PathNode* b);
+static void path_open_push(const PathNode* node);
+static void path_open_pop(PathNode* node);
+static int path_slot_alloc();
+static void path_slot_free(int slot);
 static int anim_move_to_tile(Object* obj, int tile_num, int elev, int a4, int anim, int animationSequenceIndex);
-static int anim_move(Object* obj, int tile, int elev, int a3, int anim, int a5, int animationSequenceIndex);
+static int anim_move(Object* obj, int tile, int elev, int a3, int anim, int a5, int animationSequenceIndex, bool flow);
 static int anim_move_straight_to_tile(Object* obj, int tile, int elevation, int anim, int animationSequenceIndex, int flags);
 static void object_move(int index);
 static void object_straight_move(int index);
@@ -287,17 +298,54 @@ static bool anim_in_bk = false;
 // 0x540014
 static AnimationSad sad[ANIMATION_SAD_LIST_CAPACITY];
 
-// 0x5566D4
-static PathNode dad[2000];
-
 // 0x560314
 static AnimationSequence anim_set[ANIMATION_SEQUENCE_LIST_CAPACITY];
 
-// 0x56A1E4
-static unsigned char seen[5000];
+// CE: Pathfinding state (see `make_path_func`). Open list is a binary heap,
+// closed nodes are only needed to reconstruct path, so it's enough to keep
+// parent tile and incoming rotation per tile. Visited tiles are marked with
+// search generation, so nothing needs to be cleared between searches.
+//
+// Node limit of the original implementation (for both open and closed
+// lists) is kept, it bounds time spent on unreachable destinations.
+#define PATH_NODE_CAPACITY 2000
+
+static PathNode path_open[PATH_NODE_CAPACITY];
+static int path_open_count;
+static int path_free_slots[PATH_NODE_CAPACITY];
+static int path_free_slot_count;
+static int path_next_slot;
+static unsigned short path_seen[HEX_GRID_SIZE];
+static unsigned short path_generation;
+static unsigned short path_from[HEX_GRID_SIZE];
+static unsigned char path_rotation[HEX_GRID_SIZE];
+
+// CE: Recent `make_path_func` results for `obj_blocking_at` callback. Combat
+// AI asks for the same paths several times per turn (candidate destinations,
+// then actual movement). Entries are only valid for blocking state they were
+// computed in (see `obj_blocking_version`), everything is dropped at the
+// start of every combat turn.
+#define PATH_CACHE_SIZE 32
+#define PATH_CACHE_LENGTH 800
+
+typedef struct PathCacheEntry {
+    Object* object;
+    int from;
+    int to;
+    int elevation;
+    unsigned int version;
+    int flags;
+    int length;
+    unsigned char rotations[PATH_CACHE_LENGTH];
+} PathCacheEntry;
+
+static int make_path_search(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback);
 
-// 0x54CA94
-static PathNode child[2000];
+static PathCacheEntry path_cache[PATH_CACHE_SIZE];
+static int path_cache_length = 0;
+static int path_cache_next = 0;
+static unsigned int path_cache_hits = 0;
+static unsigned int path_cache_queries = 0;
 
 // 0x56B56C
 static int curr_anim_counter;
@@ -334,6 +382,9 @@ void anim_exit()
 {
     // NOTE: Uninline.
     anim_stop();
+
+    hpath_exit();
+    flow_exit();
 }
 
 // 0x413584
@@ -1725,7 +1776,7 @@ static int anim_set_end(int animationSequenceIndex)
 }
 
 // 0x415940
-static bool anim_can_use_door(Object* critter, Object* door)
+bool anim_can_use_door(Object* critter, Object* door)
 {
     int body_type;
     Proto* door_proto;
@@ -1770,6 +1821,77 @@ int make_path(Object* object, int from, int to, unsigned char* rotations, int a5
 
 // 0x4159E8
 int make_path_func(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback)
+{
+    PROFILE_ZONE("path");
+
+    if (callback != obj_blocking_at) {
+        return make_path_search(object, from, to, rotations, a5, callback);
+    }
+
+    // CE: Path depends on the mover (it doesn't block itself, and only some
+    // critters can open doors) and on turn penalty which is only applied
+    // outside of combat.
+    unsigned int version = obj_blocking_version();
+    int flags = (a5 ? 1 : 0) | (isInCombat() ? 2 : 0);
+
+    path_cache_queries++;
+
+    for (int index = 0; index < path_cache_length; index++) {
+        PathCacheEntry* entry = &(path_cache[index]);
+        if (entry->from == from
+            && entry->to == to
+            && entry->object == object
+            && entry->elevation == object->elevation
+            && entry->version == version
+            && entry->flags == flags) {
+            if (rotations != NULL) {
+                memcpy(rotations, entry->rotations, entry->length);
+            }
+
+            path_cache_hits++;
+            return entry->length;
+        }
+    }
+
+    PathCacheEntry* entry = &(path_cache[path_cache_next]);
+    path_cache_next = (path_cache_next + 1) % PATH_CACHE_SIZE;
+    if (path_cache_length < PATH_CACHE_SIZE) {
+        path_cache_length++;
+    }
+
+    entry->object = object;
+    entry->from = from;
+    entry->to = to;
+    entry->elevation = object->elevation;
+    entry->version = version;
+    entry->flags = flags;
+    entry->length = make_path_search(object, from, to, entry->rotations, a5, callback);
+
+    if (rotations != NULL) {
+        memcpy(rotations, entry->rotations, entry->length);
+    }
+
+    return entry->length;
+}
+
+// CE: Drops cached paths (see `path_cache`).
+void make_path_cache_reset()
+{
+    path_cache_length = 0;
+    path_cache_next = 0;
+}
+
+// CE: Reports total number of cache hits and queries. Callers interested in
+// a span (a combat, a benchmark run) subtract values taken at its start, so
+// they don't reset each other's counts.
+void make_path_cache_stats(unsigned int* hits, unsigned int* queries)
+{
+    *hits = path_cache_hits;
+    *queries = path_cache_queries;
+}
+
+// CE: Actual search, see `make_path_func`.
+static int make_path_search(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback)
 {
     if (a5) {
         if (callback(object, to, object->elevation) != NULL) {
@@ -1779,72 +1901,53 @@ int make_path_func(Object* object, int from, int to, unsigned char* rotations, i
 
     bool isNotInCombat = !isInCombat();
 
-    memset(seen, 0, sizeof(seen));
+    // CE: Visited set is cleared by starting new generation.
+    path_generation++;
+    if (path_generation == 0) {
+        memset(path_seen, 0, sizeof(path_seen));
+        path_generation = 1;
+    }
 
-    seen[from / 8] |= 1 << (from & 7);
+    path_seen[from] = path_generation;
 
-    child[0].tile = from;
-    child[0].from = -1;
-    child[0].rotation = 0;
-    child[0].field_C = EST(from, to);
-    child[0].field_10 = 0;
+    path_open_count = 0;
+    path_free_slot_count = 0;
+    path_next_slot = 0;
 
-    for (int index = 1; index < 2000; index += 1) {
-        child[index].tile = -1;
-    }
+    PathNode temp;
+    temp.tile = from;
+    temp.from = -1;
+    temp.rotation = 0;
+    temp.field_C = EST(from, to);
+    temp.field_10 = 0;
+    temp.slot = path_slot_alloc();
+    path_open_push(&temp);
 
     int toScreenX;
     int toScreenY;
     tile_coord(to, &toScreenX, &toScreenY, object->elevation);
 
     int closedPathNodeListLength = 0;
-    int openPathNodeListLength = 1;
-    PathNode temp;
+    bool found = false;
 
-    while (1) {
-        int v63 = -1;
-
-        PathNode* prev = NULL;
-        int v12 = 0;
-        for (int index = 0; v12 < openPathNodeListLength; index += 1) {
-            PathNode* curr = &(child[index]);
-            if (curr->tile != -1) {
-                v12++;
-                if (v63 == -1 || (curr->field_C + curr->field_10) < (prev->field_C + prev->field_10)) {
-                    prev = curr;
-                    v63 = index;
-                }
-            }
-        }
-
-        PathNode* curr = &(child[v63]);
-
-        memcpy(&temp, curr, sizeof(temp));
-
-        openPathNodeListLength -= 1;
-
-        curr->tile = -1;
+    while (path_open_count != 0) {
+        path_open_pop(&temp);
+        path_slot_free(temp.slot);
 
         if (temp.tile == to) {
-            if (openPathNodeListLength == 0) {
-                openPathNodeListLength = 1;
-            }
+            found = true;
             break;
         }
 
-        PathNode* curr1 = &(dad[closedPathNodeListLength]);
-        memcpy(curr1, &temp, sizeof(temp));
-
         closedPathNodeListLength += 1;
 
-        if (closedPathNodeListLength == 2000) {
+        if (closedPathNodeListLength == PATH_NODE_CAPACITY) {
             return 0;
         }
 
         for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
             int tile = tile_num_in_direction(temp.tile, rotation, 1);
-            int bit = 1 << (tile & 7);
-            if ((seen[tile / 8] & bit) != 0) {
+            if (path_seen[tile] == path_generation) {
                 continue;
             }
 
@@ -1857,63 +1960,50 @@ int make_path_func(Object* object, int from, int to, unsigned char* rotations, i
                 }
             }
 
-            int v25 = 0;
-            for (; v25 < 2000; v25++) {
-                if (child[v25].tile == -1) {
-                    break;
-                }
-            }
-
-            openPathNodeListLength += 1;
-
-            if (openPathNodeListLength == 2000) {
+            if (path_open_count + 1 == PATH_NODE_CAPACITY) {
                 return 0;
             }
 
-            seen[tile / 8] |= bit;
+            path_seen[tile] = path_generation;
+            path_from[tile] = temp.tile;
+            path_rotation[tile] = rotation;
 
-            PathNode* v27 = &(child[v25]);
-            v27->tile = tile;
-            v27->from = temp.tile;
-            v27->rotation = rotation;
+            PathNode node;
+            node.tile = tile;
+            node.from = temp.tile;
+            node.rotation = rotation;
 
             int newX;
             int newY;
             tile_coord(tile, &newX, &newY, object->elevation);
 
-            v27->field_C = idist(newX, newY, toScreenX, toScreenY);
-            v27->field_10 = temp.field_10 + 50;
+            node.field_C = idist(newX, newY, toScreenX, toScreenY);
+            node.field_10 = temp.field_10 + 50;
 
             if (isNotInCombat && temp.rotation != rotation) {
-                v27->field_10 += 10;
+                node.field_10 += 10;
             }
-        }
 
-        if (openPathNodeListLength == 0) {
-            break;
+            node.slot = path_slot_alloc();
+            path_open_push(&node);
         }
     }
 
-    if (openPathNodeListLength != 0) {
+    if (found) {
         unsigned char* v39 = rotations;
+        int tile = temp.tile;
         int index = 0;
         for (; index < 800; index++) {
-            if (temp.tile == from) {
+            if (tile == from) {
                 break;
             }
 
             if (v39 != NULL) {
-                *v39 = temp.rotation & 0xFF;
+                *v39 = path_rotation[tile];
                 v39 += 1;
             }
 
-            int j = 0;
-            while (dad[j].tile != temp.from) {
-                j++;
-            }
-
-            PathNode* v36 = &(dad[j]);
-            memcpy(&temp, v36, sizeof(temp));
+            tile = path_from[tile];
         }
 
         if (rotations != NULL) {
@@ -1938,6 +2028,113 @@ int make_path_func(Object* object, int from, int to, unsigned char* rotations, i
     return 0;
 }
 
+// CE: Returns `true` if `a` should be expanded before `b`. Ties are broken
+// by open list slot, which reproduces node order of the original flat list
+// scan (lowest index wins), so paths are exactly the same.
+static inline bool path_node_less(const PathNode* a, const PathNode* b)
+{
+    int aCost = a->field_C + a->field_10;
+    int bCost = b->field_C + b->field_10;
+    if (aCost != bCost) {
+        return aCost < bCost;
+    }
+
+    return a->slot < b->slot;
+}
+
+static void path_open_push(const PathNode* node)
+{
+    int index = path_open_count++;
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!path_node_less(node, &(path_open[parent]))) {
+            break;
+        }
+
+        path_open[index] = path_open[parent];
+        index = parent;
+    }
+
+    path_open[index] = *node;
+}
+
+static void path_open_pop(PathNode* node)
+{
+    *node = path_open[0];
+
+    PathNode* last = &(path_open[--path_open_count]);
+    int index = 0;
+    while (1) {
+        int child = index * 2 + 1;
+        if (child >= path_open_count) {
+            break;
+        }
+
+        if (child + 1 < path_open_count && path_node_less(&(path_open[child + 1]), &(path_open[child]))) {
+            child++;
+        }
+
+        if (!path_node_less(&(path_open[child]), last)) {
+            break;
+        }
+
+        path_open[index] = path_open[child];
+        index = child;
+    }
+
+    path_open[index] = *last;
+}
+
+// CE: Returns lowest free slot of the original open list. Freed slots are
+// kept in a min-heap, slots above `path_next_slot` were never used.
+static int path_slot_alloc()
+{
+    if (path_free_slot_count == 0) {
+        return path_next_slot++;
+    }
+
+    int slot = path_free_slots[0];
+    int last = path_free_slots[--path_free_slot_count];
+    int index = 0;
+    while (1) {
+        int child = index * 2 + 1;
+        if (child >= path_free_slot_count) {
+            break;
+        }
+
+        if (child + 1 < path_free_slot_count && path_free_slots[child + 1] < path_free_slots[child]) {
+            child++;
+        }
+
+        if (path_free_slots[child] >= last) {
+            break;
+        }
+
+        path_free_slots[index] = path_free_slots[child];
+        index = child;
+    }
+
+    path_free_slots[index] = last;
+
+    return slot;
+}
+
+static void path_slot_free(int slot)
+{
+    int index = path_free_slot_count++;
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (path_free_slots[parent] <= slot) {
+            break;
+        }
+
+        path_free_slots[index] = path_free_slots[parent];
+        index = parent;
+    }
+
+    path_free_slots[index] = slot;
+}
+
 // 0x415D9C
 int idist(int x1, int y1, int x2, int y2)
 {
@@ -2170,11 +2367,17 @@ static int anim_move_to_object(Object* from, Object* to, int a3, int anim, int a
 {
     bool hidden = (to->flags & OBJECT_HIDDEN);
     to->flags |= OBJECT_HIDDEN;
+    obj_blocking_changed();
+
+    // CE: In combat several critters usually approach the same target, they
+    // share its distance field (see `flow_make_path`).
+    bool flow = isInCombat() && from != obj_dude && from->elevation == to->elevation;
 
-    int moveSadIndex = anim_move(from, to->tile, to->elevation, -1, anim, 0, animationSequenceIndex);
+    int moveSadIndex = anim_move(from, to->tile, to->elevation, -1, anim, 0, animationSequenceIndex, flow);
 
     if (!hidden) {
         to->flags &= ~OBJECT_HIDDEN;
+        obj_blocking_changed();
     }
 
     if (moveSadIndex == -1) {
@@ -2389,7 +2592,7 @@ static int anim_move_to_tile(Object* obj, int tile, int elev, int a4, int anim,
 {
     int v1;
 
-    v1 = anim_move(obj, tile, elev, -1, anim, 0, animationSequenceIndex);
+    v1 = anim_move(obj, tile, elev, -1, anim, 0, animationSequenceIndex, false);
     if (v1 == -1) {
         return -1;
     }
@@ -2412,7 +2615,7 @@ static int anim_move_to_tile(Object* obj, int tile, int elev, int a4, int anim,
 }
 
 // 0x416778
-static int anim_move(Object* obj, int tile, int elev, int a3, int anim, int a5, int animationSequenceIndex)
+static int anim_move(Object* obj, int tile, int elev, int a3, int anim, int a5, int animationSequenceIndex, bool flow)
 {
     if (curr_sad == ANIMATION_SAD_LIST_CAPACITY) {
         return -1;
@@ -2435,7 +2638,16 @@ static int anim_move(Object* obj, int tile, int elev, int a3, int anim, int a5,
     sad_entry->animationSequenceIndex = animationSequenceIndex;
     sad_entry->anim = anim;
 
-    sad_entry->field_1C = make_path(obj, obj->tile, tile, sad_entry->rotations, a5);
+    sad_entry->field_1C = 0;
+    if (flow) {
+        sad_entry->field_1C = flow_make_path(obj, obj->tile, tile, sad_entry->rotations);
+    }
+
+    // CE: Long routes often exceed node limit of `make_path`.
+    if (sad_entry->field_1C == 0) {
+        sad_entry->field_1C = hpath_make_path(obj, obj->tile, tile, sad_entry->rotations, a5, obj_blocking_at);
+    }
+
     if (sad_entry->field_1C == 0) {
         sad_entry->field_20 = -1000;
         return -1;
@@ -2610,7 +2822,7 @@ static void object_move(int index)
         Object* v12 = obj_blocking_at(object, v10, object->elevation);
         if (v12 != NULL) {
             if (!anim_can_use_door(object, v12)) {
-                sad_entry->field_1C = make_path(object, object->tile, sad_entry->field_24, sad_entry->rotations, 1);
+                sad_entry->field_1C = hpath_make_path(object, object->tile, sad_entry->field_24, sad_entry->rotations, 1, obj_blocking_at);
                 if (sad_entry->field_1C != 0) {
                     obj_move_to_tile(object, object->tile, object->elevation, &temp);
                     rect_min_bound(&dirty, &temp, &dirty);
@@ -2777,6 +2989,10 @@ void object_animate()
 
     anim_in_bk = 1;
 
+    // CE: Moving light sources refresh area lit before and after every step,
+    // window is updated once per tick instead of once per object.
+    tile_refresh_begin_batch();
+
     for (int index = 0; index < curr_sad; index++) {
         AnimationSad* sad_entry = &(sad[index]);
         if (sad_entry->field_20 == -1000) {
@@ -2932,6 +3148,8 @@ void object_animate()
         }
     }
 
+    tile_refresh_end_batch();
+
     anim_in_bk = 0;
 
     object_anim_compact();
@@ -3327,6 +3545,13 @@ unsigned int compute_tpf(Object* object, int fid)
 {
     int fps;
 
+#ifdef FALLOUT_PROFILE
+    // CE: Benchmark advances animations by one frame on every tick.
+    if (cbench_active()) {
+        return 0;
+    }
+#endif
+
     CacheEntry* handle;
     Art* frm = art_ptr_lock(fid, &handle);
     if (frm != NULL) {
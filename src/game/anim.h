@@ -148,6 +148,9 @@ int register_object_animate_forever(Object* owner, int anim, int delay);
 int register_ping(int a1, int a2);
 int make_path(Object* object, int from, int to, unsigned char* a4, int a5);
 int make_path_func(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback);
+void make_path_cache_reset();
+void make_path_cache_stats(unsigned int* hits, unsigned int* queries);
+bool anim_can_use_door(Object* critter, Object* door);
 int idist(int a1, int a2, int a3, int a4);
 int EST(int tile1, int tile2);
 int make_straight_path(Object* a1, int from, int to, StraightPathNode* pathNodes, Object** a5, int a6);
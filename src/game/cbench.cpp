@@ -0,0 +1,960 @@
+#include "game/cbench.h"
+
+#ifdef FALLOUT_PROFILE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "game/anim.h"
+#include "game/combat.h"
+#include "game/combat_defs.h"
+#include "game/config.h"
+#include "game/gconfig.h"
+#include "game/los.h"
+#include "game/map.h"
+#include "game/map_defs.h"
+#include "game/object.h"
+#include "game/roll.h"
+#include "game/tile.h"
+#include "platform_compat.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
+
+namespace fallout {
+
+// CE: Combat benchmark.
+//
+// Spawns critters around the player on the current map, splits them into two
+// hostile teams and runs fixed number of combat rounds between them. The
+// player joins the first team but skips turns. Animations are advanced one
+// frame per tick and frames are not presented (see `combat_turn_run`), so
+// combined with null video backend the run measures game logic only.
+//
+// Time of every AI turn is split by profiler zones and reported per round and
+// per critter in the next available `cbnNNNNN.csv`. Random generator is
+// seeded before spawning, so runs with the same settings are expected to end
+// in the same state, its hash is logged for comparison, along with path cache
+// hit rate over the combat.
+//
+// Before combat optional self checks compare optimized queries with the
+// original implementations (see `cbench_check_los` and `cbench_path`), and
+// light updates are timed (see `cbench_light`).
+
+#define CBENCH_MAX_CRITTERS 64
+#define CBENCH_MAX_ROUNDS 1000
+
+// Number of view positions shot blocking queries are checked at.
+#define CBENCH_LOS_PASSES 4
+
+// Maximum number of critters `los_shot_blocked_many` is checked with.
+#define CBENCH_LOS_TARGETS 32
+
+// Percentage of blocked tiles on the synthetic grid paths are searched on in
+// `cbench_path`.
+#define CBENCH_PATH_OBSTACLE_PERCENT 25
+
+// Capacity of open and closed lists of the original `make_path_func`.
+#define CBENCH_PATH_NODE_CAPACITY 2000
+
+// Maximum path length reported by `make_path_func`.
+#define CBENCH_PATH_LENGTH 800
+
+// Light source walking around in `cbench_light` stays this close (in hexes)
+// to its starting tile, so it's always on screen.
+#define CBENCH_LIGHT_RANGE 12
+
+// Light map is rebuilt every that many steps in `cbench_light`, as if a door
+// was opened.
+#define CBENCH_LIGHT_REBUILD_INTERVAL 16
+
+// Number of mismatches reported in detail.
+#define CBENCH_MISMATCH_REPORT_LIMIT 10
+
+// Teams unlikely to be used by map critters.
+#define CBENCH_TEAM_FIRST 90
+#define CBENCH_TEAM_SECOND 91
+
+typedef enum CbenchZone {
+    CBENCH_ZONE_TURN,
+    CBENCH_ZONE_AI,
+    CBENCH_ZONE_PATH,
+    CBENCH_ZONE_LOS,
+    CBENCH_ZONE_TO_HIT,
+    CBENCH_ZONE_ANIM,
+    CBENCH_ZONE_COUNT,
+} CbenchZone;
+
+typedef struct CbenchPathNode {
+    int tile;
+    int from;
+    int rotation;
+    int estimate;
+    int cost;
+} CbenchPathNode;
+
+typedef struct CbenchTimes {
+    int turns;
+
+    // Time spent in every `CbenchZone` (in microseconds).
+    unsigned long long zones[CBENCH_ZONE_COUNT];
+} CbenchTimes;
+
+static int cbench_spawn(int pid, int count, int aiPacket);
+static int cbench_critter_index(Object* critter);
+static void cbench_add_times(CbenchTimes* times, unsigned long long* zones);
+static int cbench_report();
+static void cbench_write_row(FILE* stream, const char* kind, int index, CbenchTimes* times);
+static unsigned long long cbench_hash();
+static int cbench_check_los(int queries);
+static bool cbench_shot_blocked(Object* a1, int from, int to, Object* a4, int* a5);
+static int cbench_random_tile(int tile, int distance);
+static int cbench_path(int queries);
+static int cbench_light(int pid, int steps);
+static Object* cbench_path_blocking_at(Object* object, int tile, int elevation);
+static int cbench_make_path(int from, int to, unsigned char* rotations, int a5);
+
+static const char* cbench_zone_names[CBENCH_ZONE_COUNT] = {
+    "combat_turn",
+    "combat_ai",
+    "path",
+    "los",
+    "to_hit",
+    "anim",
+};
+
+static int cbench_zones[CBENCH_ZONE_COUNT];
+
+static bool cbench_is_active = false;
+
+static Object* cbench_critters[CBENCH_MAX_CRITTERS];
+static int cbench_critters_length = 0;
+
+// Per round times.
+static CbenchTimes* cbench_rounds = NULL;
+static int cbench_rounds_length = 0;
+static int cbench_round = 0;
+
+// Per critter times, the last entry accumulates turns of map critters which
+// joined the fight.
+static CbenchTimes cbench_critter_times[CBENCH_MAX_CRITTERS + 1];
+
+// Blocked tiles of the synthetic grid used by `cbench_path`.
+static unsigned char cbench_path_obstacles[(HEX_GRID_SIZE + 7) / 8];
+
+// Open and closed lists and visited set of `cbench_make_path`.
+static CbenchPathNode cbench_path_open[CBENCH_PATH_NODE_CAPACITY];
+static CbenchPathNode cbench_path_closed[CBENCH_PATH_NODE_CAPACITY];
+static unsigned char cbench_path_seen[(HEX_GRID_SIZE + 7) / 8];
+
+// Path cache hits and queries during combat.
+static unsigned int cbench_path_cache_hits = 0;
+static unsigned int cbench_path_cache_queries = 0;
+
+// Critter whose turn is being measured and zone totals at its start.
+static Object* cbench_turn_critter = NULL;
+static unsigned long long cbench_turn_start[CBENCH_ZONE_COUNT];
+
+// Runs benchmark on the current map.
+//
+// Settings are read from `[debug]` section of `fallout.cfg`:
+//  - `combat_bench_critters` - number of critters to spawn (default 8).
+//  - `combat_bench_pid` - critter proto id (decimal, default 16777217, which
+//    is 0x01000001).
+//  - `combat_bench_ai_packet` - AI packet for spawned critters (default -1,
+//    keeps packet from proto).
+//  - `combat_bench_rounds` - number of combat rounds (default 10).
+//  - `combat_bench_seed` - random generator seed (default 1).
+//  - `combat_bench_los_checks` - number of random shot blocking queries
+//    checked against the original implementation (default 0).
+//  - `combat_bench_path_queries` - number of random path searches on a
+//    synthetic obstacle grid timed and checked against the original
+//    implementation (default 0).
+//  - `combat_bench_light_steps` - number of steps of a critter carrying light
+//    source walking around the player (default 0).
+int cbench_run()
+{
+    int count = 8;
+    int pid = 0x01000001;
+    int aiPacket = -1;
+    int rounds = 10;
+    int seed = 1;
+    int losChecks = 0;
+    int pathQueries = 0;
+    int lightSteps = 0;
+
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_CRITTERS_KEY, &count);
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_PID_KEY, &pid);
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_AI_PACKET_KEY, &aiPacket);
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_ROUNDS_KEY, &rounds);
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_SEED_KEY, &seed);
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_LOS_CHECKS_KEY, &losChecks);
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_PATH_QUERIES_KEY, &pathQueries);
+    config_get_value(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_LIGHT_STEPS_KEY, &lightSteps);
+
+    if (count < 2) {
+        count = 2;
+    } else if (count > CBENCH_MAX_CRITTERS) {
+        count = CBENCH_MAX_CRITTERS;
+    }
+
+    if (rounds < 1) {
+        rounds = 1;
+    } else if (rounds > CBENCH_MAX_ROUNDS) {
+        rounds = CBENCH_MAX_ROUNDS;
+    }
+
+    if (isInCombat()) {
+        debug_printf("cbench: can't run during combat\n");
+        return -1;
+    }
+
+    if (losChecks > 0) {
+        roll_set_seed(seed);
+        cbench_check_los(losChecks);
+    }
+
+    if (pathQueries > 0) {
+        roll_set_seed(seed);
+        cbench_path(pathQueries);
+    }
+
+    if (lightSteps > 0) {
+        roll_set_seed(seed);
+        cbench_light(pid, lightSteps);
+    }
+
+    cbench_rounds = (CbenchTimes*)mem_malloc(sizeof(*cbench_rounds) * rounds);
+    if (cbench_rounds == NULL) {
+        return -1;
+    }
+
+    memset(cbench_rounds, 0, sizeof(*cbench_rounds) * rounds);
+    memset(cbench_critter_times, 0, sizeof(cbench_critter_times));
+    cbench_rounds_length = rounds;
+    cbench_round = 0;
+
+    for (int zone = 0; zone < CBENCH_ZONE_COUNT; zone++) {
+        cbench_zones[zone] = profile_zone_register(cbench_zone_names[zone]);
+    }
+
+    roll_set_seed(seed);
+
+    if (cbench_spawn(pid, count, aiPacket) < 2) {
+        debug_printf("cbench: failed to spawn critters (pid %d)\n", pid);
+    } else {
+        debug_printf("cbench: %d critters (pid %d, ai packet %d), %d rounds, seed %d\n",
+            cbench_critters_length,
+            pid,
+            aiPacket,
+            rounds,
+            seed);
+
+        int dudeTeam = obj_dude->data.critter.combat.team;
+        obj_dude->data.critter.combat.team = CBENCH_TEAM_FIRST;
+
+        tile_disable_refresh();
+        cbench_is_active = true;
+
+        unsigned int pathCacheHits;
+        unsigned int pathCacheQueries;
+        make_path_cache_stats(&pathCacheHits, &pathCacheQueries);
+
+        STRUCT_664980 attack;
+        memset(&attack, 0, sizeof(attack));
+        attack.attacker = cbench_critters[0];
+        attack.defender = cbench_critters[1];
+        combat(&attack);
+
+        make_path_cache_stats(&cbench_path_cache_hits, &cbench_path_cache_queries);
+        cbench_path_cache_hits -= pathCacheHits;
+        cbench_path_cache_queries -= pathCacheQueries;
+
+        cbench_is_active = false;
+        tile_enable_refresh();
+
+        obj_dude->data.critter.combat.team = dudeTeam;
+
+        cbench_report();
+    }
+
+    for (int index = 0; index < cbench_critters_length; index++) {
+        obj_erase_object(cbench_critters[index], NULL);
+    }
+    cbench_critters_length = 0;
+
+    mem_free(cbench_rounds);
+    cbench_rounds = NULL;
+    cbench_rounds_length = 0;
+
+    tile_refresh_display();
+
+    return 0;
+}
+
+bool cbench_active()
+{
+    return cbench_is_active;
+}
+
+// Starts measuring turn of the given critter.
+void cbench_turn_begin(Object* critter)
+{
+    if (!cbench_is_active) {
+        return;
+    }
+
+    for (int zone = 0; zone < CBENCH_ZONE_COUNT; zone++) {
+        cbench_turn_start[zone] = profile_zone_total(cbench_zones[zone]);
+    }
+
+    cbench_turn_critter = critter;
+    profile_zone_enter(cbench_zones[CBENCH_ZONE_TURN]);
+}
+
+void cbench_turn_end()
+{
+    if (cbench_turn_critter == NULL) {
+        return;
+    }
+
+    profile_zone_leave(cbench_zones[CBENCH_ZONE_TURN]);
+
+    unsigned long long zones[CBENCH_ZONE_COUNT];
+    for (int zone = 0; zone < CBENCH_ZONE_COUNT; zone++) {
+        zones[zone] = profile_zone_total(cbench_zones[zone]) - cbench_turn_start[zone];
+    }
+
+    if (cbench_round < cbench_rounds_length) {
+        cbench_add_times(&(cbench_rounds[cbench_round]), zones);
+    }
+
+    cbench_add_times(&(cbench_critter_times[cbench_critter_index(cbench_turn_critter)]), zones);
+
+    cbench_turn_critter = NULL;
+}
+
+// Called when combat round is over, returns `true` when benchmark is done.
+bool cbench_round_end()
+{
+    cbench_round++;
+    return cbench_round >= cbench_rounds_length;
+}
+
+// Places critters on free tiles around the player, alternating teams.
+// Returns number of critters placed.
+static int cbench_spawn(int pid, int count, int aiPacket)
+{
+    cbench_critters_length = 0;
+
+    for (int distance = 2; distance < 20 && cbench_critters_length < count; distance++) {
+        for (int rotation = 0; rotation < ROTATION_COUNT && cbench_critters_length < count; rotation++) {
+            int tile = tile_num_in_direction(obj_dude->tile, rotation, distance);
+            if (tile == obj_dude->tile || obj_blocking_at(NULL, tile, obj_dude->elevation) != NULL) {
+                continue;
+            }
+
+            Object* critter;
+            if (obj_pid_new(&critter, pid) == -1) {
+                return cbench_critters_length;
+            }
+
+            if (PID_TYPE(critter->pid) != OBJ_TYPE_CRITTER) {
+                obj_erase_object(critter, NULL);
+                return cbench_critters_length;
+            }
+
+            obj_move_to_tile(critter, tile, obj_dude->elevation, NULL);
+
+            critter->data.critter.combat.team = cbench_critters_length % 2 == 0 ? CBENCH_TEAM_SECOND : CBENCH_TEAM_FIRST;
+            if (aiPacket != -1) {
+                critter->data.critter.combat.aiPacket = aiPacket;
+            }
+
+            cbench_critters[cbench_critters_length++] = critter;
+        }
+    }
+
+    return cbench_critters_length;
+}
+
+static int cbench_critter_index(Object* critter)
+{
+    for (int index = 0; index < cbench_critters_length; index++) {
+        if (cbench_critters[index] == critter) {
+            return index;
+        }
+    }
+
+    return CBENCH_MAX_CRITTERS;
+}
+
+static void cbench_add_times(CbenchTimes* times, unsigned long long* zones)
+{
+    times->turns++;
+
+    for (int zone = 0; zone < CBENCH_ZONE_COUNT; zone++) {
+        times->zones[zone] += zones[zone];
+    }
+}
+
+// Writes results into the next available `cbnNNNNN.csv`.
+static int cbench_report()
+{
+    CbenchTimes total;
+    memset(&total, 0, sizeof(total));
+
+    for (int round = 0; round < cbench_rounds_length; round++) {
+        total.turns += cbench_rounds[round].turns;
+        for (int zone = 0; zone < CBENCH_ZONE_COUNT; zone++) {
+            total.zones[zone] += cbench_rounds[round].zones[zone];
+        }
+    }
+
+    unsigned long long hash = cbench_hash();
+
+    debug_printf("cbench: %d rounds, %d turns, %.3f ms (ai %.3f, path %.3f, los %.3f, to_hit %.3f, anim %.3f), hash %016llx\n",
+        cbench_round,
+        total.turns,
+        total.zones[CBENCH_ZONE_TURN] / 1000.0,
+        total.zones[CBENCH_ZONE_AI] / 1000.0,
+        total.zones[CBENCH_ZONE_PATH] / 1000.0,
+        total.zones[CBENCH_ZONE_LOS] / 1000.0,
+        total.zones[CBENCH_ZONE_TO_HIT] / 1000.0,
+        total.zones[CBENCH_ZONE_ANIM] / 1000.0,
+        hash);
+
+    debug_printf("cbench: path cache %u hits of %u queries (%.1f%%)\n",
+        cbench_path_cache_hits,
+        cbench_path_cache_queries,
+        cbench_path_cache_queries != 0 ? cbench_path_cache_hits * 100.0 / cbench_path_cache_queries : 0.0);
+
+    char fileName[16];
+    FILE* stream;
+    int index;
+
+    for (index = 0; index < 100000; index++) {
+        snprintf(fileName, sizeof(fileName), "cbn%.5d.csv", index);
+
+        stream = compat_fopen(fileName, "rb");
+        if (stream == NULL) {
+            break;
+        }
+
+        fclose(stream);
+    }
+
+    if (index == 100000) {
+        return -1;
+    }
+
+    stream = compat_fopen(fileName, "wt");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    fprintf(stream, "kind,index,turns,turn_ms,ai_ms,path_ms,los_ms,to_hit_ms,anim_ms\n");
+
+    for (int round = 0; round < cbench_rounds_length; round++) {
+        cbench_write_row(stream, "round", round, &(cbench_rounds[round]));
+    }
+
+    for (int critter = 0; critter < cbench_critters_length; critter++) {
+        cbench_write_row(stream, "critter", critter, &(cbench_critter_times[critter]));
+    }
+
+    if (cbench_critter_times[CBENCH_MAX_CRITTERS].turns != 0) {
+        cbench_write_row(stream, "other", 0, &(cbench_critter_times[CBENCH_MAX_CRITTERS]));
+    }
+
+    cbench_write_row(stream, "total", 0, &total);
+
+    fprintf(stream, "hash,%016llx,,,,,,,\n", hash);
+
+    fclose(stream);
+
+    debug_printf("cbench: results saved to %s\n", fileName);
+
+    return 0;
+}
+
+static void cbench_write_row(FILE* stream, const char* kind, int index, CbenchTimes* times)
+{
+    fprintf(stream, "%s,%d,%d", kind, index, times->turns);
+
+    for (int zone = 0; zone < CBENCH_ZONE_COUNT; zone++) {
+        fprintf(stream, ",%.3f", times->zones[zone] / 1000.0);
+    }
+
+    fprintf(stream, "\n");
+}
+
+// Hashes (FNV-1a, 64-bit) state of the player and spawned critters.
+static unsigned long long cbench_hash()
+{
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (int index = -1; index < cbench_critters_length; index++) {
+        Object* critter = index == -1 ? obj_dude : cbench_critters[index];
+
+        int values[7];
+        values[0] = critter->tile;
+        values[1] = critter->elevation;
+        values[2] = critter->rotation;
+        values[3] = critter->fid;
+        values[4] = critter->data.critter.hp;
+        values[5] = critter->data.critter.combat.results;
+        values[6] = critter->data.critter.combat.ap;
+
+        unsigned char* bytes = (unsigned char*)values;
+        for (size_t byte = 0; byte < sizeof(values); byte++) {
+            hash ^= bytes[byte];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+// Compares shot blocking queries (see `los.cpp`) with the original stepping
+// of `make_straight_path` on random tile pairs around the player. Cached lines
+// are built in screen coordinates, so the view is moved between passes to
+// check they do not depend on it. Returns number of mismatches.
+static int cbench_check_los(int queries)
+{
+    int elevation = obj_dude->elevation;
+    int center = tile_center_tile;
+
+    Object* targets[CBENCH_LOS_TARGETS];
+    bool blocked[CBENCH_LOS_TARGETS];
+    int targetsLength = 0;
+
+    Object* object = obj_find_first_at(elevation);
+    while (object != NULL && targetsLength < CBENCH_LOS_TARGETS) {
+        if (PID_TYPE(object->pid) == OBJ_TYPE_CRITTER) {
+            targets[targetsLength++] = object;
+        }
+        object = obj_find_next_at();
+    }
+
+    int checks = 0;
+    int mismatches = 0;
+
+    tile_disable_refresh();
+
+    for (int pass = 0; pass < CBENCH_LOS_PASSES; pass++) {
+        tile_set_center(cbench_random_tile(center, 20), TILE_SET_CENTER_FLAG_IGNORE_SCROLL_RESTRICTIONS);
+
+        for (int query = pass; query < queries; query += CBENCH_LOS_PASSES) {
+            // Lines longer than `LOS_LINE_LENGTH` are not cached, these
+            // are checked as well.
+            int from = cbench_random_tile(obj_dude->tile, 30);
+            int to = cbench_random_tile(from, 50);
+            Object* target = obj_blocking_at(NULL, to, elevation);
+
+            Object* expectedObstacle = obj_dude;
+            make_straight_path(obj_dude, from, to, NULL, &expectedObstacle, 32);
+
+            Object* obstacle = obj_dude;
+            los_straight_obstacle(obj_dude, from, to, &obstacle);
+
+            int expectedCount;
+            bool expectedBlocked = cbench_shot_blocked(obj_dude, from, to, target, &expectedCount);
+
+            int count;
+            bool isBlocked = los_shot_blocked(obj_dude, from, to, target, &count);
+
+            checks++;
+
+            if (obstacle != expectedObstacle || isBlocked != expectedBlocked || count != expectedCount) {
+                if (mismatches < CBENCH_MISMATCH_REPORT_LIMIT) {
+                    debug_printf("cbench: los mismatch %d -> %d (elevation %d, center %d): obstacle %p/%p, blocked %d/%d, critters %d/%d\n",
+                        from,
+                        to,
+                        elevation,
+                        tile_center_tile,
+                        obstacle,
+                        expectedObstacle,
+                        isBlocked,
+                        expectedBlocked,
+                        count,
+                        expectedCount);
+                }
+                mismatches++;
+            }
+        }
+
+        for (int source = 0; source < targetsLength; source++) {
+            Object* attacker = targets[source];
+            los_shot_blocked_many(attacker, targets, targetsLength, blocked);
+
+            for (int index = 0; index < targetsLength; index++) {
+                bool expectedBlocked = cbench_shot_blocked(attacker, attacker->tile, targets[index]->tile, targets[index], NULL);
+
+                checks++;
+
+                if (blocked[index] != expectedBlocked) {
+                    if (mismatches < CBENCH_MISMATCH_REPORT_LIMIT) {
+                        debug_printf("cbench: los many mismatch %d -> %d (elevation %d, center %d): blocked %d/%d\n",
+                            attacker->tile,
+                            targets[index]->tile,
+                            attacker->elevation,
+                            tile_center_tile,
+                            blocked[index],
+                            expectedBlocked);
+                    }
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    tile_set_center(center, TILE_SET_CENTER_FLAG_IGNORE_SCROLL_RESTRICTIONS);
+    tile_enable_refresh();
+
+    debug_printf("cbench: los %d checks, %d mismatches%s\n",
+        checks,
+        mismatches,
+        mismatches != 0 ? " - FAILED" : "");
+
+    return mismatches;
+}
+
+// Original `combat_is_shot_blocked`, steps `make_straight_path` from obstacle
+// to obstacle.
+static bool cbench_shot_blocked(Object* a1, int from, int to, Object* a4, int* a5)
+{
+    Object* obstacle = a1;
+
+    if (a5 != NULL) {
+        *a5 = 0;
+    }
+
+    while (obstacle != NULL && from != to) {
+        make_straight_path(a1, from, to, NULL, &obstacle, 32);
+        if (obstacle != NULL) {
+            if (FID_TYPE(obstacle->fid) != OBJ_TYPE_CRITTER) {
+                return true;
+            }
+
+            if (a5 != NULL) {
+                if (obstacle != a4) {
+                    *a5 += 1;
+                }
+            }
+
+            from = obstacle->tile;
+        }
+    }
+
+    return false;
+}
+
+// Returns random tile within `distance` hexes of `tile` (two legs in random
+// directions, so lines are not limited to hex axes).
+static int cbench_random_tile(int tile, int distance)
+{
+    tile = tile_num_in_direction(tile, roll_random(0, ROTATION_COUNT - 1), roll_random(0, distance / 2));
+    return tile_num_in_direction(tile, roll_random(0, ROTATION_COUNT - 1), roll_random(0, distance / 2));
+}
+
+// Times `make_path_func` and `cbench_make_path` on the same random tile pairs
+// on a seeded synthetic obstacle grid, and checks both find the same paths.
+// The grid covers the whole map and does not depend on the loaded one, so
+// timings are comparable between runs with the same seed. Returns number of
+// mismatches.
+static int cbench_path(int queries)
+{
+    for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+        if (roll_random(1, 100) <= CBENCH_PATH_OBSTACLE_PERCENT) {
+            cbench_path_obstacles[tile / 8] |= 1 << (tile & 7);
+        } else {
+            cbench_path_obstacles[tile / 8] &= ~(1 << (tile & 7));
+        }
+    }
+
+    int zoneOld = profile_zone_register("cbench_path_old");
+    int zoneNew = profile_zone_register("cbench_path_new");
+    unsigned long long startOld = profile_zone_total(zoneOld);
+    unsigned long long startNew = profile_zone_total(zoneNew);
+
+    unsigned char expectedRotations[CBENCH_PATH_LENGTH];
+    unsigned char rotations[CBENCH_PATH_LENGTH];
+
+    int found = 0;
+    int steps = 0;
+    int mismatches = 0;
+
+    for (int query = 0; query < queries; query++) {
+        // Targets are kept within a typical combat distance, most searches
+        // over the whole grid would run out of nodes.
+        int from = roll_random(0, HEX_GRID_SIZE - 1);
+        int to = cbench_random_tile(from, 40);
+        int a5 = roll_random(0, 1);
+
+        profile_zone_enter(zoneOld);
+        int expectedLength = cbench_make_path(from, to, expectedRotations, a5);
+        profile_zone_leave(zoneOld);
+
+        // Callback other than `obj_blocking_at` bypasses path cache, so
+        // every query is an actual search.
+        profile_zone_enter(zoneNew);
+        int length = make_path_func(obj_dude, from, to, rotations, a5, cbench_path_blocking_at);
+        profile_zone_leave(zoneNew);
+
+        if (length != 0) {
+            found++;
+            steps += length;
+        }
+
+        if (length != expectedLength || memcmp(rotations, expectedRotations, length) != 0) {
+            if (mismatches < CBENCH_MISMATCH_REPORT_LIMIT) {
+                debug_printf("cbench: path mismatch %d -> %d (a5 %d): length %d/%d\n",
+                    from,
+                    to,
+                    a5,
+                    length,
+                    expectedLength);
+            }
+            mismatches++;
+        }
+    }
+
+    unsigned long long timeOld = profile_zone_total(zoneOld) - startOld;
+    unsigned long long timeNew = profile_zone_total(zoneNew) - startNew;
+
+    debug_printf("cbench: path %d queries on %d%% obstacle grid (%d found, %d steps), original %.3f ms, current %.3f ms, %d mismatches%s\n",
+        queries,
+        CBENCH_PATH_OBSTACLE_PERCENT,
+        found,
+        steps,
+        timeOld / 1000.0,
+        timeNew / 1000.0,
+        mismatches,
+        mismatches != 0 ? " - FAILED" : "");
+
+    return mismatches;
+}
+
+// Returns any non-NULL object for tiles blocked on the synthetic grid. Paths
+// are searched for the player, who never opens doors (see
+// `anim_can_use_door`), so the object itself is never looked at.
+static Object* cbench_path_blocking_at(Object* object, int tile, int elevation)
+{
+    if ((cbench_path_obstacles[tile / 8] & (1 << (tile & 7))) != 0) {
+        return obj_dude;
+    }
+
+    return NULL;
+}
+
+// Equivalence oracle for `cbench_path`: original `make_path_func` reduced to
+// the synthetic grid, open list is scanned for the cheapest node on every
+// step. Ties go to the first node in the open list, which is what the current
+// implementation has to reproduce.
+static int cbench_make_path(int from, int to, unsigned char* rotations, int a5)
+{
+    if (a5 && cbench_path_blocking_at(NULL, to, 0) != NULL) {
+        return 0;
+    }
+
+    bool isNotInCombat = !isInCombat();
+
+    memset(cbench_path_seen, 0, sizeof(cbench_path_seen));
+    cbench_path_seen[from / 8] |= 1 << (from & 7);
+
+    cbench_path_open[0].tile = from;
+    cbench_path_open[0].from = -1;
+    cbench_path_open[0].rotation = 0;
+    cbench_path_open[0].estimate = EST(from, to);
+    cbench_path_open[0].cost = 0;
+
+    for (int index = 1; index < CBENCH_PATH_NODE_CAPACITY; index++) {
+        cbench_path_open[index].tile = -1;
+    }
+
+    int toScreenX;
+    int toScreenY;
+    tile_coord(to, &toScreenX, &toScreenY, obj_dude->elevation);
+
+    int closedLength = 0;
+    int openLength = 1;
+    CbenchPathNode node;
+
+    while (1) {
+        int best = -1;
+        for (int index = 0, seen = 0; seen < openLength; index++) {
+            CbenchPathNode* curr = &(cbench_path_open[index]);
+            if (curr->tile != -1) {
+                seen++;
+                if (best == -1 || curr->estimate + curr->cost < cbench_path_open[best].estimate + cbench_path_open[best].cost) {
+                    best = index;
+                }
+            }
+        }
+
+        node = cbench_path_open[best];
+        cbench_path_open[best].tile = -1;
+        openLength--;
+
+        if (node.tile == to) {
+            break;
+        }
+
+        cbench_path_closed[closedLength++] = node;
+        if (closedLength == CBENCH_PATH_NODE_CAPACITY) {
+            return 0;
+        }
+
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+            int tile = tile_num_in_direction(node.tile, rotation, 1);
+            int bit = 1 << (tile & 7);
+            if ((cbench_path_seen[tile / 8] & bit) != 0) {
+                continue;
+            }
+
+            if (tile != to && cbench_path_blocking_at(NULL, tile, 0) != NULL) {
+                continue;
+            }
+
+            int slot = 0;
+            while (cbench_path_open[slot].tile != -1) {
+                slot++;
+            }
+
+            openLength++;
+            if (openLength == CBENCH_PATH_NODE_CAPACITY) {
+                return 0;
+            }
+
+            cbench_path_seen[tile / 8] |= bit;
+
+            int x;
+            int y;
+            tile_coord(tile, &x, &y, obj_dude->elevation);
+
+            CbenchPathNode* next = &(cbench_path_open[slot]);
+            next->tile = tile;
+            next->from = node.tile;
+            next->rotation = rotation;
+            next->estimate = idist(x, y, toScreenX, toScreenY);
+            next->cost = node.cost + 50;
+
+            if (isNotInCombat && node.rotation != rotation) {
+                next->cost += 10;
+            }
+        }
+
+        if (openLength == 0) {
+            return 0;
+        }
+    }
+
+    int length = 0;
+    while (length < CBENCH_PATH_LENGTH && node.tile != from) {
+        rotations[length++] = node.rotation & 0xFF;
+
+        int index = 0;
+        while (cbench_path_closed[index].tile != node.from) {
+            index++;
+        }
+        node = cbench_path_closed[index];
+    }
+
+    for (int index = 0; index < length / 2; index++) {
+        unsigned char rotation = rotations[index];
+        rotations[index] = rotations[length - 1 - index];
+        rotations[length - 1 - index] = rotation;
+    }
+
+    return length;
+}
+
+// Times light updates of a critter carrying light source which walks around
+// the player, one step per animation tick, with light map rebuilt now and
+// then. Screen is refreshed as usual, so lit area is redrawn after every
+// step.
+static int cbench_light(int pid, int steps)
+{
+    int elevation = obj_dude->elevation;
+    int start = tile_num_in_direction(obj_dude->tile, ROTATION_NE, 2);
+    if (obj_blocking_at(NULL, start, elevation) != NULL) {
+        debug_printf("cbench: light start tile %d is blocked\n", start);
+        return -1;
+    }
+
+    Object* critter;
+    if (obj_pid_new(&critter, pid) == -1) {
+        return -1;
+    }
+
+    Rect rect;
+    obj_move_to_tile(critter, start, elevation, NULL);
+    obj_set_light(critter, 8, 0x10000, NULL);
+
+    int zoneStep = profile_zone_register("cbench_light_step");
+    int zoneRebuild = profile_zone_register("light_rebuild");
+    int zoneRefresh = profile_zone_register("tile_refresh");
+    unsigned long long startStep = profile_zone_total(zoneStep);
+    unsigned long long startRebuild = profile_zone_total(zoneRebuild);
+    unsigned long long startRefresh = profile_zone_total(zoneRefresh);
+
+    int rotation = roll_random(0, ROTATION_COUNT - 1);
+    int moves = 0;
+
+    for (int step = 0; step < steps; step++) {
+        int tile = critter->tile;
+        for (int attempt = 0; attempt < ROTATION_COUNT; attempt++) {
+            int next = tile_num_in_direction(critter->tile, rotation, 1);
+            if (next != critter->tile
+                && tile_dist(next, start) <= CBENCH_LIGHT_RANGE
+                && obj_blocking_at(critter, next, elevation) == NULL) {
+                tile = next;
+                break;
+            }
+
+            rotation = roll_random(0, ROTATION_COUNT - 1);
+        }
+
+        profile_zone_enter(zoneStep);
+
+        // Same as an animation tick (see `object_animate`).
+        tile_refresh_begin_batch();
+        if (tile != critter->tile) {
+            obj_move_to_tile(critter, tile, elevation, &rect);
+            tile_refresh_rect(&rect, elevation);
+            moves++;
+        }
+        tile_refresh_end_batch();
+
+        if (step % CBENCH_LIGHT_REBUILD_INTERVAL == CBENCH_LIGHT_REBUILD_INTERVAL - 1) {
+            if (obj_rebuild_light(&rect) == 0) {
+                tile_refresh_rect(&rect, elevation);
+            }
+        }
+
+        profile_zone_leave(zoneStep);
+    }
+
+    unsigned long long timeStep = profile_zone_total(zoneStep) - startStep;
+    unsigned long long timeRebuild = profile_zone_total(zoneRebuild) - startRebuild;
+    unsigned long long timeRefresh = profile_zone_total(zoneRefresh) - startRefresh;
+
+    debug_printf("cbench: light %d steps (%d moves, %d rebuilds), %.3f ms (%.1f us per step), rebuild %.3f ms, refresh %.3f ms\n",
+        steps,
+        moves,
+        steps / CBENCH_LIGHT_REBUILD_INTERVAL,
+        timeStep / 1000.0,
+        (double)timeStep / steps,
+        timeRebuild / 1000.0,
+        timeRefresh / 1000.0);
+
+    obj_erase_object(critter, &rect);
+    tile_refresh_rect(&rect, elevation);
+
+    return 0;
+}
+
+} // namespace fallout
+
+#endif /* FALLOUT_PROFILE */
@@ -0,0 +1,23 @@
+#ifndef FALLOUT_GAME_CBENCH_H_
+#define FALLOUT_GAME_CBENCH_H_
+
+#include "game/object_types.h"
+
+namespace fallout {
+
+// CE: Headless combat benchmark, available in profiling builds only (see
+// `plib/gnw/profile.h`).
+
+#ifdef FALLOUT_PROFILE
+
+int cbench_run();
+bool cbench_active();
+void cbench_turn_begin(Object* critter);
+void cbench_turn_end();
+bool cbench_round_end();
+
+#endif
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_CBENCH_H_ */
@@ -7,6 +7,7 @@
 #include "game/actions.h"
 #include "game/anim.h"
 #include "game/art.h"
+#include "game/cbench.h"
 #include "game/combatai.h"
 #include "game/critter.h"
 #include "game/display.h"
@@ -18,6 +19,7 @@
 #include "game/intface.h"
 #include "game/item.h"
 #include "game/loadsave.h"
+#include "game/los.h"
 #include "game/map.h"
 #include "game/object.h"
 #include "game/perk.h"
@@ -39,6 +41,7 @@
 #include "plib/gnw/grbuf.h"
 #include "plib/gnw/input.h"
 #include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
 #include "plib/gnw/svga.h"
 #include "plib/gnw/text.h"
 
@@ -49,6 +52,43 @@ namespace fallout {
 #define CALLED_SHOT_WINDOW_WIDTH 424
 #define CALLED_SHOT_WINDOW_HEIGHT 309
 
+// CE: Number of entries in `to_hit_memo`.
+#define TO_HIT_MEMO_SIZE 256
+
+// CE: Everything `determine_to_hit_func` depends on besides stats, skills,
+// perks, traits and options, changes of which invalidate the whole memo (see
+// `combat_to_hit_invalidate`).
+typedef struct ToHitKey {
+    Object* attacker;
+    Object* defender;
+    Object* weapon;
+    int attackerId;
+    int defenderId;
+    int weaponPid;
+    int hitLocation;
+    int hitMode;
+    int checkRange;
+    int attackerTile;
+    int defenderTile;
+    int attackerResults;
+    int defenderResults;
+    int defenderActionPoints;
+    int attackerFlags;
+    int defenderFlags;
+    int attackerTeam;
+    int dudeTeam;
+    int light;
+    unsigned int blockingVersion;
+    STRUCT_664980* gcsd;
+    int accuracyBonus;
+} ToHitKey;
+
+typedef struct ToHitMemoEntry {
+    unsigned int generation;
+    ToHitKey key;
+    int accuracy;
+} ToHitMemoEntry;
+
 static void combat_begin(Object* a1);
 static void combat_begin_extra(Object* a1);
 static void combat_over();
@@ -67,6 +107,8 @@ static int attack_crit_success(Attack* a1);
 static int attack_crit_failure(Attack* attack);
 static void do_random_cripple(int* flagsPtr);
 static int determine_to_hit_func(Object* attacker, Object* defender, int hitLocation, int hitMode, int check_range);
+static int determine_to_hit_memo(Object* attacker, Object* defender, int hitLocation, int hitMode, int check_range);
+static int determine_to_hit_compute(Object* attacker, Object* defender, int hitLocation, int hitMode, int check_range);
 static void compute_damage(Attack* attack, int ammoQuantity, int bonusDamageMultiplier);
 static void check_for_death(Object* a1, int a2, int* a3);
 static void set_new_results(Object* a1, int a2);
@@ -1546,6 +1588,22 @@ int combat_exps;
 // 0x56BC9C
 int combat_free_move;
 
+// CE: Results of `determine_to_hit_func` during current turn. AI asks for
+// the same shots many times while choosing hit modes and called shots, and
+// the interface asks again on every mouse move over a target.
+static ToHitMemoEntry to_hit_memo[TO_HIT_MEMO_SIZE];
+
+// CE: Entries of `to_hit_memo` from other generations are stale.
+static unsigned int to_hit_memo_generation = 1;
+
+static int to_hit_memo_hits = 0;
+static int to_hit_memo_queries = 0;
+
+// CE: Path cache counters at the start of current combat (see
+// `combat_over`).
+static unsigned int combat_path_cache_hits = 0;
+static unsigned int combat_path_cache_queries = 0;
+
 // 0x41F810
 int combat_init()
 {
@@ -1613,6 +1671,9 @@ void combat_reset()
 void combat_exit()
 {
     message_exit(&combat_message_file);
+
+    // CE: Reports line cache usage.
+    los_exit();
 }
 
 // 0x41F960
@@ -1757,6 +1818,13 @@ static void combat_begin(Object* a1)
     combat_elev = map_elevation;
 
     if (!isInCombat()) {
+        // CE: Start counting path cache hits for this combat (see
+        // `combat_over`).
+        make_path_cache_stats(&combat_path_cache_hits, &combat_path_cache_queries);
+
+        to_hit_memo_hits = 0;
+        to_hit_memo_queries = 0;
+
         combat_exps = 0;
         combat_list = NULL;
         list_total = obj_create_list(-1, combat_elev, OBJ_TYPE_CRITTER, &combat_list);
@@ -1807,6 +1875,9 @@ static void combat_begin_extra(Object* a1)
 
     combat_turn_obj = a1;
 
+    // CE: Combat could be loaded from a save.
+    combat_to_hit_invalidate();
+
     combat_ai_begin(list_total, combat_list);
 
     combat_highlight = 2;
@@ -1818,6 +1889,25 @@ static void combat_over()
 {
     int index;
 
+    unsigned int pathCacheHits;
+    unsigned int pathCacheQueries;
+    make_path_cache_stats(&pathCacheHits, &pathCacheQueries);
+    pathCacheHits -= combat_path_cache_hits;
+    pathCacheQueries -= combat_path_cache_queries;
+    if (pathCacheQueries != 0) {
+        debug_printf("combat: path cache %u hits of %u queries (%.1f%%)\n",
+            pathCacheHits,
+            pathCacheQueries,
+            pathCacheHits * 100.0 / pathCacheQueries);
+    }
+
+    if (to_hit_memo_queries != 0) {
+        debug_printf("combat: to-hit memo %d hits of %d queries (%.1f%%)\n",
+            to_hit_memo_hits,
+            to_hit_memo_queries,
+            to_hit_memo_hits * 100.0 / to_hit_memo_queries);
+    }
+
     add_bk_process(dude_fidget);
 
     for (index = 0; index < list_noncom + list_com; index++) {
@@ -1941,7 +2031,15 @@ static void combat_add_noncoms()
             list_noncom -= 1;
 
             if (obj != obj_dude) {
+#ifdef FALLOUT_PROFILE
+                cbench_turn_begin(obj);
+#endif
+
                 combat_turn(obj, false);
+
+#ifdef FALLOUT_PROFILE
+                cbench_turn_end();
+#endif
             }
         }
     }
@@ -2143,7 +2241,18 @@ void combat_end()
 // 0x420698
 void combat_turn_run()
 {
+    PROFILE_ZONE("anim");
+
     while (combat_turn_running > 0) {
+#ifdef FALLOUT_PROFILE
+        // CE: Benchmark steps animations as fast as possible, without
+        // presenting frames.
+        if (cbench_active()) {
+            process_bk();
+            continue;
+        }
+#endif
+
         sharedFpsLimiter.mark();
 
         process_bk();
@@ -2232,6 +2341,13 @@ static int combat_turn(Object* a1, bool a2)
 
     combat_turn_obj = a1;
 
+    // CE: Paths are shared within a turn only.
+    make_path_cache_reset();
+
+    // CE: So is to-hit memo, other critters' armor class depends on whose
+    // turn it is.
+    combat_to_hit_invalidate();
+
     combat_ctd_init(&main_ctd, a1, NULL, HIT_MODE_PUNCH, HIT_LOCATION_TORSO);
 
     if ((a1->data.critter.combat.results & (DAM_KNOCKED_OUT | DAM_DEAD | DAM_LOSE_TURN)) != 0) {
@@ -2351,6 +2467,13 @@ static int combat_turn(Object* a1, bool a2)
 // 0x420A54
 static bool combat_should_end()
 {
+#ifdef FALLOUT_PROFILE
+    // CE: Benchmark runs fixed number of rounds.
+    if (cbench_active() && cbench_round_end()) {
+        return true;
+    }
+#endif
+
     if (list_com <= 1) {
         return true;
     }
@@ -2429,7 +2552,22 @@ void combat(STRUCT_664980* attack)
             }
 
             for (; v6 < list_com; v6++) {
-                if (combat_turn(combat_list[v6], false) == -1) {
+#ifdef FALLOUT_PROFILE
+                // CE: Benchmark times AI turns, player sits them out.
+                if (cbench_active() && combat_list[v6] == obj_dude) {
+                    continue;
+                }
+
+                cbench_turn_begin(combat_list[v6]);
+#endif
+
+                int rc = combat_turn(combat_list[v6], false);
+
+#ifdef FALLOUT_PROFILE
+                cbench_turn_end();
+#endif
+
+                if (rc == -1) {
                     break;
                 }
 
@@ -3235,6 +3373,79 @@ int determine_to_hit_no_range(Object* a1, Object* a2, int hitLocation, int hitMo
 
 // 0x421E3C
 static int determine_to_hit_func(Object* attacker, Object* defender, int hitLocation, int hitMode, int check_range)
+{
+    PROFILE_ZONE("to_hit");
+
+    // CE: Queries are only repeated within combat turns.
+    if (isInCombat()) {
+        return determine_to_hit_memo(attacker, defender, hitLocation, hitMode, check_range);
+    }
+
+    return determine_to_hit_compute(attacker, defender, hitLocation, hitMode, check_range);
+}
+
+// CE: Same as `determine_to_hit_compute`, but remembers results until
+// something they depend on changes.
+static int determine_to_hit_memo(Object* attacker, Object* defender, int hitLocation, int hitMode, int check_range)
+{
+    ToHitKey key;
+    memset(&key, 0, sizeof(key));
+
+    key.attacker = attacker;
+    key.defender = defender;
+    key.weapon = item_hit_with(attacker, hitMode);
+    key.attackerId = attacker->id;
+    key.defenderId = defender->id;
+    key.weaponPid = key.weapon != NULL ? key.weapon->pid : -1;
+    key.hitLocation = hitLocation;
+    key.hitMode = hitMode;
+    key.checkRange = check_range;
+    key.attackerTile = attacker->tile;
+    key.defenderTile = defender->tile;
+    key.attackerResults = attacker->data.critter.combat.results;
+    key.defenderResults = defender->data.critter.combat.results;
+    key.defenderActionPoints = defender->data.critter.combat.ap;
+    key.attackerFlags = attacker->flags & OBJECT_MULTIHEX;
+    key.defenderFlags = defender->flags & OBJECT_MULTIHEX;
+    key.attackerTeam = attacker->data.critter.combat.team;
+    key.dudeTeam = obj_dude->data.critter.combat.team;
+    key.light = attacker == obj_dude ? obj_get_visible_light(defender) : 0;
+    key.blockingVersion = obj_blocking_version();
+    key.gcsd = gcsd;
+    key.accuracyBonus = gcsd != NULL ? gcsd->accuracyBonus : 0;
+
+    unsigned int hash = (unsigned int)attacker->id * 2654435761u
+        ^ (unsigned int)defender->id * 40503u
+        ^ (unsigned int)(hitLocation * 16 + hitMode) * 2246822519u;
+    ToHitMemoEntry* entry = &(to_hit_memo[(hash >> 8) % TO_HIT_MEMO_SIZE]);
+
+    to_hit_memo_queries++;
+
+    if (entry->generation == to_hit_memo_generation && memcmp(&(entry->key), &key, sizeof(key)) == 0) {
+        to_hit_memo_hits++;
+        return entry->accuracy;
+    }
+
+    entry->generation = to_hit_memo_generation;
+    entry->key = key;
+    entry->accuracy = determine_to_hit_compute(attacker, defender, hitLocation, hitMode, check_range);
+
+    return entry->accuracy;
+}
+
+// CE: Forgets all remembered to-hit chances. Called whenever stats, skills,
+// perks, traits or options change, and at the start of every turn.
+void combat_to_hit_invalidate()
+{
+    to_hit_memo_generation++;
+    if (to_hit_memo_generation == 0) {
+        memset(to_hit_memo, 0, sizeof(to_hit_memo));
+        to_hit_memo_generation = 1;
+    }
+}
+
+// CE: Original `determine_to_hit_func`.
+static int determine_to_hit_compute(Object* attacker, Object* defender, int hitLocation, int hitMode, int check_range)
 {
     Object* weapon;
     bool is_ranged_weapon = false;
@@ -4459,7 +4670,9 @@ int combat_check_bad_shot(Object* attacker, Object* defender, int hitMode, bool
     }
 
     if (attack_type == ATTACK_TYPE_RANGED || attack_type == ATTACK_TYPE_THROW) {
-        if (combat_is_shot_blocked(attacker, attacker->tile, defender->tile, defender, NULL)) {
+        // CE: AI checks the same shots many times per turn, results for
+        // combatants are kept until something moves.
+        if (ai_shot_blocked(attacker, defender)) {
             return COMBAT_BAD_SHOT_AIM_BLOCKED;
         }
     }
@@ -4679,30 +4892,9 @@ void combat_highlight_change()
 // 0x4242B4
 bool combat_is_shot_blocked(Object* a1, int from, int to, Object* a4, int* a5)
 {
-    Object* obstacle = a1;
-
-    if (a5 != NULL) {
-        *a5 = 0;
-    }
-
-    while (obstacle != NULL && from != to) {
-        make_straight_path(a1, from, to, NULL, &obstacle, 32);
-        if (obstacle != NULL) {
-            if (FID_TYPE(obstacle->fid) != OBJ_TYPE_CRITTER) {
-                return true;
-            }
-
-            if (a5 != NULL) {
-                if (obstacle != a4) {
-                    *a5 += 1;
-                }
-            }
-
-            from = obstacle->tile;
-        }
-    }
-
-    return false;
+    // CE: Walks cached tile sequences instead of stepping `make_straight_path`
+    // from obstacle to obstacle (see `los_shot_blocked`).
+    return los_shot_blocked(a1, from, to, a4, a5);
 }
 
 // 0x424338
@@ -54,6 +54,7 @@ void combat_outline_on();
 void combat_outline_off();
 void combat_highlight_change();
 bool combat_is_shot_blocked(Object* a1, int from, int to, Object* a4, int* a5);
+void combat_to_hit_invalidate();
 int combat_player_knocked_out_by();
 int combat_explode_scenery(Object* a1, Object* a2);
 void combat_delete_critter(Object* obj);
@@ -16,6 +16,7 @@
 #include "game/intface.h"
 #include "game/item.h"
 #include "game/light.h"
+#include "game/los.h"
 #include "game/map.h"
 #include "game/object.h"
 #include "game/perk.h"
@@ -31,9 +32,30 @@
 #include "plib/gnw/debug.h"
 #include "plib/gnw/input.h"
 #include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
 
 namespace fallout {
 
+// CE: Combatant as seen by `ai_matrix_distance` and `ai_matrix_los`.
+typedef struct AiMatrixRow {
+    // `NULL` when critter was removed from combat.
+    Object* critter;
+
+    // Tile of the critter when its distances were computed.
+    int tile;
+
+    // Value of `obj_blocking_version` when shots from the critter were
+    // checked, valid only if `losValid` is set.
+    unsigned int losVersion;
+    bool losValid;
+} AiMatrixRow;
+
+// CE: Remembered `art_exists` result (see `ai_art_exists`).
+typedef struct AiArtMemoEntry {
+    int fid;
+    bool exists;
+} AiArtMemoEntry;
+
 typedef enum HurtTooMuch {
     HURT_BLIND,
     HURT_CRIPPLED,
@@ -64,6 +86,13 @@ static int ai_attack(Object* critter, Object* target, int hit_mode);
 static int ai_try_attack(Object* critter, Object* target);
 static int ai_print_msg(Object* critter, int type);
 static int combatai_rating(Object* obj);
+static bool ai_art_exists(int fid);
+static void ai_art_memo_reset();
+static void ai_matrix_init(int critters_count, Object** critters);
+static void ai_matrix_exit();
+static int ai_matrix_index(Object* obj);
+static void ai_matrix_refresh(int index);
+static int ai_obj_dist(Object* object1, Object* object2);
 static int combatai_load_messages();
 static int combatai_unload_messages();
 
@@ -112,6 +141,37 @@ static Object** curr_crit_list;
 // 0x56BE60
 static char attack_str[80];
 
+// CE: Snapshot of combatants made in `combat_ai_begin` in the original
+// order (`curr_crit_list` is reordered by sorting).
+static AiMatrixRow* ai_matrix_rows = NULL;
+static int ai_matrix_size = 0;
+
+// CE: `tile_dist` between tiles of combatants (see `AiMatrixRow`), rows and
+// columns of critters which have moved are recomputed on access.
+static short* ai_matrix_distance = NULL;
+
+// CE: Whether shot from one combatant to another is blocked, whole row is
+// computed at once and kept until something moves.
+static bool* ai_matrix_los = NULL;
+
+// CE: Scratch list of shot targets (see `ai_shot_blocked`).
+static Object** ai_matrix_targets = NULL;
+
+static int ai_matrix_distance_refreshes = 0;
+static int ai_matrix_los_rows = 0;
+static int ai_matrix_los_queries = 0;
+
+// CE: Number of entries in `ai_art_memo`.
+#define AI_ART_MEMO_SIZE 128
+
+// CE: Animations probed while choosing weapons and hit modes. Each probe
+// builds art file name and looks it up in the database, while the answer
+// never changes during combat.
+static AiArtMemoEntry ai_art_memo[AI_ART_MEMO_SIZE];
+static bool ai_art_memo_enabled = false;
+static int ai_art_memo_hits = 0;
+static int ai_art_memo_misses = 0;
+
 // 0x424450
 static void parse_hurt_str(char* str, int* value)
 {
@@ -464,8 +524,9 @@ static int compare_nearer(const void* critter_ptr1, const void* critter_ptr2)
         }
     }
 
-    distance1 = obj_dist(critter1, combat_obj);
-    distance2 = obj_dist(critter2, combat_obj);
+    // CE: Read distances from matrix.
+    distance1 = ai_obj_dist(critter1, combat_obj);
+    distance2 = ai_obj_dist(critter2, combat_obj);
 
     if (distance1 < distance2) {
         return -1;
@@ -701,16 +762,18 @@ static bool ai_can_use_weapon(Object* critter, Object* weapon, int hitMode)
         return false;
     }
 
+    // CE: Skill is checked before animation, both checks have no side
+    // effects, but the former is cheaper.
+    if (skill_level(critter, item_w_skill(weapon, hitMode)) < ai_cap(critter)->min_to_hit) {
+        return false;
+    }
+
     fid = art_id(OBJ_TYPE_CRITTER,
         critter->fid & 0xFFF,
         item_w_anim_weap(weapon, hitMode),
         item_w_anim_code(weapon),
         critter->rotation + 1);
-    if (!art_exists(fid)) {
-        return false;
-    }
-
-    if (skill_level(critter, item_w_skill(weapon, hitMode)) < ai_cap(critter)->min_to_hit) {
+    if (!ai_art_exists(fid)) {
         return false;
     }
 
@@ -1032,7 +1095,7 @@ static int ai_try_attack(Object* critter, Object* target)
     if (weapon == NULL) {
         if (critter_body_type(target) != BODY_TYPE_BIPED
             || (target->fid & 0xF000) >> 12 != 0
-            || !art_exists(art_id(OBJ_TYPE_CRITTER, critter->fid & 0xFFF, ANIM_THROW_PUNCH, 0, critter->rotation + 1))) {
+            || !ai_art_exists(art_id(OBJ_TYPE_CRITTER, critter->fid & 0xFFF, ANIM_THROW_PUNCH, 0, critter->rotation + 1))) {
             ai_switch_weapons(critter, &hit_mode, &weapon);
         }
     }
@@ -1175,6 +1238,10 @@ void combat_ai_begin(int critters_count, Object** critters)
             curr_crit_num = 0;
         }
     }
+
+    ai_matrix_init(curr_crit_num, critters);
+    ai_art_memo_reset();
+    ai_art_memo_enabled = true;
 }
 
 // 0x425C0C
@@ -1185,11 +1252,24 @@ void combat_ai_over()
     }
 
     curr_crit_num = 0;
+
+    ai_matrix_exit();
+
+    if (ai_art_memo_hits + ai_art_memo_misses != 0) {
+        debug_printf("combat_ai: %d of %d animation probes remembered\n",
+            ai_art_memo_hits,
+            ai_art_memo_hits + ai_art_memo_misses);
+    }
+
+    ai_art_memo_reset();
+    ai_art_memo_enabled = false;
 }
 
 // 0x425C2C
 Object* combat_ai(Object* critter, Object* target)
 {
+    PROFILE_ZONE("combat_ai");
+
     AiPacket* ai;
     CritterCombatData* combatData;
 
@@ -1580,7 +1660,8 @@ bool is_within_perception(Object* critter1, Object* critter2)
     int perception;
     int max_distance;
 
-    distance = obj_dist(critter2, critter1);
+    // CE: Read distance from matrix.
+    distance = ai_obj_dist(critter2, critter1);
     perception = stat_level(critter1, STAT_PERCEPTION);
     if (can_see(critter1, critter2)) {
         max_distance = perception * 5;
@@ -1703,6 +1784,244 @@ void combatai_delete_critter(Object* critter)
             break;
         }
     }
+
+    // CE: Object might be destroyed, forget it so that its address is never
+    // matched again.
+    index = ai_matrix_index(critter);
+    if (index != -1) {
+        ai_matrix_rows[index].critter = NULL;
+    }
+}
+
+// CE: Returns `true` if shot from `attacker` to `defender` is blocked, same as
+// `combat_is_shot_blocked(attacker, attacker->tile, defender->tile, defender,
+// NULL)`.
+//
+// When both are combatants shots from `attacker` to every combatant are
+// checked at once (see `los_shot_blocked_many`) and reused until something
+// moves.
+bool ai_shot_blocked(Object* attacker, Object* defender)
+{
+    int row = ai_matrix_index(attacker);
+    int column = row != -1 ? ai_matrix_index(defender) : -1;
+    if (column == -1 || attacker->tile == -1 || defender->tile == -1) {
+        return combat_is_shot_blocked(attacker, attacker->tile, defender->tile, defender, NULL);
+    }
+
+    ai_matrix_los_queries++;
+
+    AiMatrixRow* rowInfo = &(ai_matrix_rows[row]);
+    unsigned int version = obj_blocking_version();
+    if (!rowInfo->losValid || rowInfo->losVersion != version) {
+        // Only combatants on the map are checked, others are always
+        // rechecked on the next query.
+        int count = 0;
+        for (int index = 0; index < ai_matrix_size; index++) {
+            Object* critter = ai_matrix_rows[index].critter;
+            if (critter != NULL && critter->tile != -1) {
+                ai_matrix_targets[count++] = critter;
+            }
+        }
+
+        bool* blocked = &(ai_matrix_los[row * ai_matrix_size]);
+        los_shot_blocked_many(attacker, ai_matrix_targets, count, blocked);
+
+        // Spread results to columns of their critters (from the end so that
+        // results are not overwritten before they are moved).
+        for (int index = ai_matrix_size - 1; index >= 0; index--) {
+            Object* critter = ai_matrix_rows[index].critter;
+            if (critter != NULL && critter->tile != -1) {
+                blocked[index] = blocked[--count];
+            }
+        }
+
+        rowInfo->losVersion = version;
+        rowInfo->losValid = true;
+
+        ai_matrix_los_rows++;
+    }
+
+    if (ai_matrix_rows[column].critter == NULL) {
+        return combat_is_shot_blocked(attacker, attacker->tile, defender->tile, defender, NULL);
+    }
+
+    return ai_matrix_los[row * ai_matrix_size + column];
+}
+
+// CE: Makes snapshot of combatants (see `AiMatrixRow`).
+static void ai_matrix_init(int critters_count, Object** critters)
+{
+    ai_matrix_exit();
+
+    if (critters_count == 0) {
+        return;
+    }
+
+    ai_matrix_rows = (AiMatrixRow*)mem_malloc(sizeof(*ai_matrix_rows) * critters_count);
+    ai_matrix_distance = (short*)mem_malloc(sizeof(*ai_matrix_distance) * critters_count * critters_count);
+    ai_matrix_los = (bool*)mem_malloc(sizeof(*ai_matrix_los) * critters_count * critters_count);
+    ai_matrix_targets = (Object**)mem_malloc(sizeof(*ai_matrix_targets) * critters_count);
+    if (ai_matrix_rows == NULL || ai_matrix_distance == NULL || ai_matrix_los == NULL || ai_matrix_targets == NULL) {
+        ai_matrix_exit();
+        return;
+    }
+
+    ai_matrix_size = critters_count;
+
+    for (int row = 0; row < critters_count; row++) {
+        AiMatrixRow* rowInfo = &(ai_matrix_rows[row]);
+        rowInfo->critter = critters[row];
+        rowInfo->tile = critters[row]->tile;
+        rowInfo->losValid = false;
+    }
+
+    for (int row = 0; row < critters_count; row++) {
+        for (int column = 0; column < critters_count; column++) {
+            ai_matrix_distance[row * critters_count + column] = tile_dist(ai_matrix_rows[row].tile, ai_matrix_rows[column].tile);
+        }
+    }
+
+    ai_matrix_distance_refreshes = 0;
+    ai_matrix_los_rows = 0;
+    ai_matrix_los_queries = 0;
+}
+
+static void ai_matrix_exit()
+{
+    if (ai_matrix_size != 0) {
+        debug_printf("combat_ai: %d combatants, %d distance rows refreshed, %d shot rows for %d queries\n",
+            ai_matrix_size,
+            ai_matrix_distance_refreshes,
+            ai_matrix_los_rows,
+            ai_matrix_los_queries);
+    }
+
+    if (ai_matrix_rows != NULL) {
+        mem_free(ai_matrix_rows);
+        ai_matrix_rows = NULL;
+    }
+
+    if (ai_matrix_distance != NULL) {
+        mem_free(ai_matrix_distance);
+        ai_matrix_distance = NULL;
+    }
+
+    if (ai_matrix_los != NULL) {
+        mem_free(ai_matrix_los);
+        ai_matrix_los = NULL;
+    }
+
+    if (ai_matrix_targets != NULL) {
+        mem_free(ai_matrix_targets);
+        ai_matrix_targets = NULL;
+    }
+
+    ai_matrix_size = 0;
+}
+
+// CE: Returns index of combatant in matrix, or -1 if object is not a
+// combatant.
+static int ai_matrix_index(Object* obj)
+{
+    if (obj == NULL || ai_matrix_size == 0) {
+        return -1;
+    }
+
+    // Combat id is index in combat list which matches matrix until combat
+    // list is reordered.
+    if (obj->cid >= 0 && obj->cid < ai_matrix_size && ai_matrix_rows[obj->cid].critter == obj) {
+        return obj->cid;
+    }
+
+    for (int index = 0; index < ai_matrix_size; index++) {
+        if (ai_matrix_rows[index].critter == obj) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+// CE: Recomputes row and column of combatant if it has moved.
+static void ai_matrix_refresh(int index)
+{
+    AiMatrixRow* rowInfo = &(ai_matrix_rows[index]);
+    int tile = rowInfo->critter->tile;
+    if (rowInfo->tile == tile) {
+        return;
+    }
+
+    rowInfo->tile = tile;
+
+    for (int other = 0; other < ai_matrix_size; other++) {
+        int otherTile = ai_matrix_rows[other].tile;
+        ai_matrix_distance[index * ai_matrix_size + other] = tile_dist(tile, otherTile);
+        ai_matrix_distance[other * ai_matrix_size + index] = tile_dist(otherTile, tile);
+    }
+
+    ai_matrix_distance_refreshes++;
+}
+
+// CE: Same as `obj_dist`, but distances between combatants are read from
+// matrix.
+static int ai_obj_dist(Object* object1, Object* object2)
+{
+    int index1 = ai_matrix_index(object1);
+    int index2 = index1 != -1 ? ai_matrix_index(object2) : -1;
+    if (index2 == -1) {
+        return obj_dist(object1, object2);
+    }
+
+    ai_matrix_refresh(index1);
+    ai_matrix_refresh(index2);
+
+    int distance = ai_matrix_distance[index1 * ai_matrix_size + index2];
+
+    if ((object1->flags & OBJECT_MULTIHEX) != 0) {
+        distance -= 1;
+    }
+
+    if ((object2->flags & OBJECT_MULTIHEX) != 0) {
+        distance -= 1;
+    }
+
+    if (distance < 0) {
+        distance = 0;
+    }
+
+    return distance;
+}
+
+// CE: Same as `art_exists`, but remembers answers until the end of combat.
+static bool ai_art_exists(int fid)
+{
+    // Weapons are also evaluated outside of combat (`ai_search_inven`).
+    if (!ai_art_memo_enabled) {
+        return art_exists(fid);
+    }
+
+    AiArtMemoEntry* entry = &(ai_art_memo[((unsigned int)fid * 2654435761u >> 8) % AI_ART_MEMO_SIZE]);
+    if (entry->fid == fid) {
+        ai_art_memo_hits++;
+        return entry->exists;
+    }
+
+    ai_art_memo_misses++;
+
+    entry->fid = fid;
+    entry->exists = art_exists(fid);
+
+    return entry->exists;
+}
+
+static void ai_art_memo_reset()
+{
+    for (int index = 0; index < AI_ART_MEMO_SIZE; index++) {
+        ai_art_memo[index].fid = -1;
+    }
+
+    ai_art_memo_hits = 0;
+    ai_art_memo_misses = 0;
 }
 
 } // namespace fallout
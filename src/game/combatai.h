@@ -60,6 +60,7 @@ int combatai_msg(Object* critter, Attack* attack, int message_type, int delay);
 Object* combat_ai_random_target(Attack* attack);
 void combatai_check_retaliation(Object* critter, Object* candidate);
 bool is_within_perception(Object* critter1, Object* critter2);
+bool ai_shot_blocked(Object* attacker, Object* defender);
 void combatai_refresh_messages();
 void combatai_notify_onlookers(Object* critter);
 void combatai_delete_critter(Object* critter);
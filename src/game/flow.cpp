@@ -0,0 +1,247 @@
+#include "game/flow.h"
+
+#include <string.h>
+
+#include "game/anim.h"
+#include "game/map_defs.h"
+#include "game/object.h"
+#include "game/tile.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
+
+namespace fallout {
+
+// CE: Distance fields.
+//
+// When several critters approach the same target (typically the player in
+// combat) each of them used to search its own path. Instead distance to the
+// target is computed once for every tile around it, and every critter simply
+// walks downhill.
+//
+// Field is built lazily, breadth-first search from the target only goes as
+// far as the farthest critter which asked for path so far.
+//
+// Field only reflects map layout (walls and scenery other than doors, see
+// `obj_static_blocking_at`), so it stays valid while critters move around.
+// Critters and doors are checked while walking down the field, a critter
+// which cannot make progress falls back to the usual search.
+
+#define FLOW_FIELD_COUNT 4
+
+// Number of tiles within `FLOW_MAX_DISTANCE` from any tile.
+#define FLOW_QUEUE_CAPACITY (3 * FLOW_MAX_DISTANCE * (FLOW_MAX_DISTANCE + 1) + 1)
+
+// Distance of tiles which are too far.
+#define FLOW_UNREACHED 255
+
+// Distance of tiles which are blocked.
+#define FLOW_BLOCKED 254
+
+typedef struct FlowField {
+    int target;
+    int elevation;
+    unsigned int version;
+    unsigned int mru;
+
+    // Distance to the target (in hexes) by tile.
+    unsigned char* distance;
+
+    // Breadth-first search state, tiles in `queue` before `head` are
+    // expanded.
+    unsigned short* queue;
+    int head;
+    int tail;
+} FlowField;
+
+static FlowField* flow_field(int target, int elevation);
+static void flow_expand(FlowField* field, int tile);
+
+static FlowField flow_fields[FLOW_FIELD_COUNT];
+static unsigned int flow_mru = 0;
+
+static int flow_builds = 0;
+static int flow_queries = 0;
+static int flow_paths = 0;
+
+void flow_exit()
+{
+    if (flow_queries != 0) {
+        debug_printf("flow: %d fields started, %d of %d paths found\n", flow_builds, flow_paths, flow_queries);
+    }
+
+    for (int index = 0; index < FLOW_FIELD_COUNT; index++) {
+        FlowField* field = &(flow_fields[index]);
+        if (field->distance != NULL) {
+            mem_free(field->distance);
+            field->distance = NULL;
+            field->queue = NULL;
+        }
+        field->target = -1;
+    }
+}
+
+// Builds path for `object` from `from` to `to` by following distance field
+// of `to`. Rules are the same as in `make_path_func` with `obj_blocking_at`
+// callback: destination tile may be occupied, other tiles must be free or
+// have door `object` can open.
+//
+// Returns path length, or 0 if `from` is too far from `to` or the way is
+// blocked by critters or doors, in which case caller should search path
+// instead.
+int flow_make_path(Object* object, int from, int to, unsigned char* rotations)
+{
+    PROFILE_ZONE("path");
+
+    if (from == to || !hexGridTileIsValid(from) || !hexGridTileIsValid(to)) {
+        return 0;
+    }
+
+    flow_queries++;
+
+    FlowField* field = flow_field(to, object->elevation);
+    if (field == NULL) {
+        return 0;
+    }
+
+    flow_expand(field, from);
+
+    unsigned char* distance = field->distance;
+    if (distance[from] > FLOW_MAX_DISTANCE) {
+        return 0;
+    }
+
+    int tile = from;
+    int length = 0;
+    while (tile != to) {
+        int bestRotation = -1;
+        int bestTile = -1;
+        int bestDistance = distance[tile];
+
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+            int neighbor = tile_num_in_direction(tile, rotation, 1);
+            if (neighbor == tile || !hexGridTileIsValid(neighbor)) {
+                continue;
+            }
+
+            if (distance[neighbor] >= bestDistance) {
+                continue;
+            }
+
+            if (neighbor != to) {
+                Object* obstacle = obj_blocking_at(object, neighbor, object->elevation);
+                if (obstacle != NULL && !anim_can_use_door(object, obstacle)) {
+                    continue;
+                }
+            }
+
+            bestRotation = rotation;
+            bestTile = neighbor;
+            bestDistance = distance[neighbor];
+        }
+
+        if (bestRotation == -1) {
+            return 0;
+        }
+
+        if (rotations != NULL) {
+            rotations[length] = bestRotation;
+        }
+
+        length++;
+        tile = bestTile;
+    }
+
+    flow_paths++;
+
+    return length;
+}
+
+// Returns up to date field for given target, resetting least recently used
+// one if needed.
+static FlowField* flow_field(int target, int elevation)
+{
+    unsigned int version = obj_blocking_static_version();
+
+    FlowField* victim = &(flow_fields[0]);
+    for (int index = 0; index < FLOW_FIELD_COUNT; index++) {
+        FlowField* field = &(flow_fields[index]);
+        if (field->distance != NULL
+            && field->target == target
+            && field->elevation == elevation
+            && field->version == version) {
+            field->mru = ++flow_mru;
+            return field;
+        }
+
+        if (field->mru < victim->mru) {
+            victim = field;
+        }
+    }
+
+    if (victim->distance == NULL) {
+        // Distances and queue share single block.
+        victim->distance = (unsigned char*)mem_malloc(HEX_GRID_SIZE + sizeof(*victim->queue) * FLOW_QUEUE_CAPACITY);
+        if (victim->distance == NULL) {
+            return NULL;
+        }
+
+        victim->queue = (unsigned short*)(victim->distance + HEX_GRID_SIZE);
+    }
+
+    victim->target = target;
+    victim->elevation = elevation;
+    victim->version = version;
+    victim->mru = ++flow_mru;
+
+    memset(victim->distance, FLOW_UNREACHED, HEX_GRID_SIZE);
+    victim->distance[target] = 0;
+    victim->queue[0] = target;
+    victim->head = 0;
+    victim->tail = 1;
+
+    flow_builds++;
+
+    return victim;
+}
+
+// Continues breadth-first search from the target over tiles not blocked by
+// map layout until distance of `tile` is known.
+//
+// NOTE: When tile gets its distance all tiles closer to the target already
+// have theirs, which is all `flow_make_path` needs.
+static void flow_expand(FlowField* field, int tile)
+{
+    unsigned char* distance = field->distance;
+    while (distance[tile] == FLOW_UNREACHED && field->head < field->tail) {
+        int current = field->queue[field->head];
+        int next = distance[current] + 1;
+        if (next > FLOW_MAX_DISTANCE) {
+            field->head = field->tail;
+            break;
+        }
+
+        field->head++;
+
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+            int neighbor = tile_num_in_direction(current, rotation, 1);
+            if (neighbor == current || !hexGridTileIsValid(neighbor)) {
+                continue;
+            }
+
+            if (distance[neighbor] != FLOW_UNREACHED) {
+                continue;
+            }
+
+            if (obj_static_blocking_at(neighbor, field->elevation)) {
+                distance[neighbor] = FLOW_BLOCKED;
+                continue;
+            }
+
+            distance[neighbor] = next;
+            field->queue[field->tail++] = neighbor;
+        }
+    }
+}
+
+} // namespace fallout
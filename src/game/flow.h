@@ -0,0 +1,17 @@
+#ifndef FALLOUT_GAME_FLOW_H_
+#define FALLOUT_GAME_FLOW_H_
+
+#include "game/object_types.h"
+
+namespace fallout {
+
+// CE: Critters farther than this (in hexes) from the target are not covered
+// by distance field (see `flow_make_path`).
+#define FLOW_MAX_DISTANCE 40
+
+void flow_exit();
+int flow_make_path(Object* object, int from, int to, unsigned char* rotations);
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_FLOW_H_ */
@@ -165,7 +165,7 @@ int game_init(const char* windowTitle, bool isMapper, int font, int flags, int a
     DbgPrint("game_init: calling win_set_minimized_title\n");
     win_set_minimized_title(windowTitle);
 
-    VideoOptions video_options = {640, 480, true, 1};
+    VideoOptions video_options = {640, 480, true, 1, SCALE_FILTER_NEAREST, false, false, false};
 
     DbgPrint("game_init: loading resolution config\n");
     Config resolutionConfig;
@@ -196,6 +196,30 @@ int game_init(const char* windowTitle, bool isMapper, int font, int flags, int a
         config_exit(&resolutionConfig);
     }
 
+    // CE: Headless video backend and frame capture, used for automated
+    // rendering regression runs (e.g. `[system]video_backend=null`).
+    char* videoBackend;
+    if (config_get_string(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_VIDEO_BACKEND_KEY, &videoBackend)) {
+        video_options.headless = compat_stricmp(videoBackend, "null") == 0;
+    }
+
+    // CE: Upscaling filter for SCALE_2X (`nearest` or `scale2x`).
+    char* scaleFilter;
+    if (config_get_string(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_SCALE_FILTER_KEY, &scaleFilter)) {
+        if (compat_stricmp(scaleFilter, "scale2x") == 0) {
+            video_options.scaleFilter = SCALE_FILTER_SCALE2X;
+        }
+    }
+
+    configGetBool(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_FRAME_HASH_KEY, &(video_options.frameHash));
+    configGetBool(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_FRAME_DUMP_KEY, &(video_options.frameDump));
+
+    // CE: Derived color tables cache, empty value disables it.
+    char* colorCache;
+    if (config_get_string(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_COLOR_CACHE_KEY, &colorCache)) {
+        colorSetCacheDirectory(colorCache);
+    }
+
     DbgPrint("game_init: calling initWindow\n");
     initWindow(&video_options, flags);
     DbgPrint("game_init: calling palette_init\n");
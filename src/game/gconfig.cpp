@@ -83,10 +83,12 @@ bool gconfig_init(bool isMapper, int argc, char** argv)
     char fullMasterDat[256];
     char fullCritterDat[256];
     char fullDataPath[256];
+    char fullColorCachePath[256];
 
     snprintf(fullMasterDat, sizeof(fullMasterDat), "%s\\master.dat", basePath);
     snprintf(fullCritterDat, sizeof(fullCritterDat), "%s\\critter.dat", basePath);
     snprintf(fullDataPath, sizeof(fullDataPath), "%s\\data", basePath);
+    snprintf(fullColorCachePath, sizeof(fullColorCachePath), "%s\\data\\cache", basePath);
 
     // DbgPrint("gconfig_init: fullMasterDat = %s\n", fullMasterDat);
     // DbgPrint("gconfig_init: fullCritterDat = %s\n", fullCritterDat);
@@ -104,7 +106,9 @@ bool gconfig_init(bool isMapper, int argc, char** argv)
     config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_SCROLL_LOCK_KEY, 0);
     config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_INTERRUPT_WALK_KEY, 1);
     config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_ART_CACHE_SIZE_KEY, 8);
+    config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_FLOOR_CACHE_SIZE_KEY, 1024);
     config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_COLOR_CYCLING_KEY, 1);
+    config_set_string(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_COLOR_CACHE_KEY, fullColorCachePath);
     config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_HASHING_KEY, 1);
     config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_SPLASH_KEY, 0);
     config_set_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_FREE_SPACE_KEY, 20480);
@@ -24,6 +24,12 @@ namespace fallout {
 #define GAME_CONFIG_SCROLL_LOCK_KEY "scroll_lock"
 #define GAME_CONFIG_INTERRUPT_WALK_KEY "interrupt_walk"
 #define GAME_CONFIG_ART_CACHE_SIZE_KEY "art_cache_size"
+#define GAME_CONFIG_FLOOR_CACHE_SIZE_KEY "floor_cache_size"
+#define GAME_CONFIG_VIDEO_BACKEND_KEY "video_backend"
+#define GAME_CONFIG_FRAME_HASH_KEY "frame_hash"
+#define GAME_CONFIG_FRAME_DUMP_KEY "frame_dump"
+#define GAME_CONFIG_SCALE_FILTER_KEY "scale_filter"
+#define GAME_CONFIG_COLOR_CACHE_KEY "color_cache"
 #define GAME_CONFIG_COLOR_CYCLING_KEY "color_cycling"
 #define GAME_CONFIG_CYCLE_SPEED_FACTOR_KEY "cycle_speed_factor"
 #define GAME_CONFIG_HASHING_KEY "hashing"
@@ -81,6 +87,15 @@ namespace fallout {
 #define GAME_CONFIG_RUN_MAPPER_AS_GAME_KEY "run_mapper_as_game"
 #define GAME_CONFIG_DEFAULT_F8_AS_GAME_KEY "default_f8_as_game"
 #define GAME_CONFIG_PLAYER_SPEEDUP_KEY "player_speedup"
+#define GAME_CONFIG_COMBAT_BENCH_MAP_KEY "combat_bench_map"
+#define GAME_CONFIG_COMBAT_BENCH_CRITTERS_KEY "combat_bench_critters"
+#define GAME_CONFIG_COMBAT_BENCH_PID_KEY "combat_bench_pid"
+#define GAME_CONFIG_COMBAT_BENCH_AI_PACKET_KEY "combat_bench_ai_packet"
+#define GAME_CONFIG_COMBAT_BENCH_ROUNDS_KEY "combat_bench_rounds"
+#define GAME_CONFIG_COMBAT_BENCH_SEED_KEY "combat_bench_seed"
+#define GAME_CONFIG_COMBAT_BENCH_LOS_CHECKS_KEY "combat_bench_los_checks"
+#define GAME_CONFIG_COMBAT_BENCH_PATH_QUERIES_KEY "combat_bench_path_queries"
+#define GAME_CONFIG_COMBAT_BENCH_LIGHT_STEPS_KEY "combat_bench_light_steps"
 
 #define ENGLISH "english"
 #define FRENCH "french"
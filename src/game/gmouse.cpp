@@ -11,6 +11,7 @@
 #include "game/game.h"
 #include "game/gconfig.h"
 #include "game/gsound.h"
+#include "game/hpath.h"
 #include "game/intface.h"
 #include "game/item.h"
 #include "game/map.h"
@@ -766,7 +767,8 @@ void gmouse_bk_process()
 
         char formattedActionPoints[8];
         int color;
-        int v6 = make_path(obj_dude, obj_dude->tile, obj_mouse_flat->tile, NULL, 1);
+        // CE: Use the same planner as movement itself (see `anim_move`).
+        int v6 = hpath_make_path(obj_dude, obj_dude->tile, obj_mouse_flat->tile, NULL, 1, obj_blocking_at);
         if (v6) {
             if (!isInCombat()) {
                 formattedActionPoints[0] = '\0';
@@ -0,0 +1,611 @@
+#include "game/hpath.h"
+
+#include <string.h>
+
+#include "game/map_defs.h"
+#include "game/object.h"
+#include "game/tile.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
+
+namespace fallout {
+
+// CE: Hierarchical path planner.
+//
+// Hex grid is split into square clusters (in tile coordinates). Open tiles
+// of every cluster are grouped into connected areas, which are nodes of
+// abstract graph. Two nodes are connected when some tile of one is adjacent
+// to some tile of another, edge remembers crossing tile nearest to centers of
+// both clusters.
+//
+// Graph only reflects map layout (walls and scenery other than doors), so
+// it's only rebuilt when such objects appear or disappear, and only in
+// affected clusters. Critters and doors are dealt with when route found in
+// graph is refined with `make_path_func` between crossings close to each
+// other.
+
+#define HPATH_CLUSTER_SIZE 10
+#define HPATH_CLUSTER_COLUMNS (HEX_GRID_WIDTH / HPATH_CLUSTER_SIZE)
+#define HPATH_CLUSTER_ROWS (HEX_GRID_HEIGHT / HPATH_CLUSTER_SIZE)
+#define HPATH_CLUSTER_COUNT (HPATH_CLUSTER_COLUMNS * HPATH_CLUSTER_ROWS)
+#define HPATH_CLUSTER_AREA (HPATH_CLUSTER_SIZE * HPATH_CLUSTER_SIZE)
+
+// Tiles of areas beyond this limit are treated as unreachable.
+#define HPATH_COMPONENT_MAX 8
+
+#define HPATH_NODE_COUNT (HPATH_CLUSTER_COUNT * HPATH_COMPONENT_MAX)
+#define HPATH_EDGE_MAX 12
+#define HPATH_OPEN_CAPACITY 4096
+#define HPATH_WAYPOINT_CAPACITY 256
+
+// Component of blocked tile.
+#define HPATH_NO_COMPONENT 0xFF
+
+// Component of open tile in area beyond `HPATH_COMPONENT_MAX`.
+#define HPATH_LOST_COMPONENT 0xFE
+
+// Max distance between consecutive refinement targets.
+#define HPATH_REFINE_DISTANCE 16
+
+// Max path length, same as `make_path_func`.
+#define HPATH_PATH_LENGTH 800
+
+typedef struct HPathEdge {
+    unsigned short node;
+
+    // First tile of path in `node`.
+    unsigned short tile;
+} HPathEdge;
+
+typedef struct HPathNode {
+    unsigned char edgeCount;
+    HPathEdge edges[HPATH_EDGE_MAX];
+} HPathNode;
+
+typedef struct HPathOpenNode {
+    int cost;
+    int node;
+} HPathOpenNode;
+
+typedef struct HPathGraph {
+    // Elevation graph is built for, or -1.
+    int elevation;
+
+    bool dirty;
+    bool clusterDirty[HPATH_CLUSTER_COUNT];
+    unsigned char componentCount[HPATH_CLUSTER_COUNT];
+    unsigned char component[HEX_GRID_SIZE];
+    HPathNode nodes[HPATH_NODE_COUNT];
+
+    // Search state.
+    unsigned short generation;
+    unsigned short seen[HPATH_NODE_COUNT];
+    unsigned short closed[HPATH_NODE_COUNT];
+    int cost[HPATH_NODE_COUNT];
+    unsigned short parent[HPATH_NODE_COUNT];
+    unsigned short entry[HPATH_NODE_COUNT];
+    HPathOpenNode open[HPATH_OPEN_CAPACITY];
+    int openCount;
+} HPathGraph;
+
+static bool hpath_prepare(int elevation);
+static void hpath_build_components(int cluster);
+static void hpath_build_edges(int cluster);
+static int hpath_find(int from, int to, unsigned short* waypoints);
+static int hpath_refine(Object* object, int from, unsigned short* waypoints, int waypointCount, unsigned char* rotations, PathBuilderCallback* callback);
+static bool hpath_open_push(int node, int cost);
+static int hpath_open_pop();
+static inline int hpath_cluster(int tile);
+static int hpath_cluster_center(int cluster);
+static inline int hpath_node(int tile);
+static int hpath_distance(int tile1, int tile2);
+
+// Allocated on first long route.
+static HPathGraph* hpath_graph = NULL;
+
+static unsigned char hpath_segment[HPATH_PATH_LENGTH];
+
+static int hpath_planned_count = 0;
+static int hpath_fallback_count = 0;
+static int hpath_rebuilt_count = 0;
+
+// Forgets graph, it's rebuilt for the next long route.
+void hpath_reset()
+{
+    if (hpath_graph != NULL) {
+        hpath_graph->elevation = -1;
+    }
+}
+
+void hpath_exit()
+{
+    if (hpath_graph != NULL) {
+        debug_printf("hpath: %d routes planned, %d fallbacks, %d clusters rebuilt\n",
+            hpath_planned_count,
+            hpath_fallback_count,
+            hpath_rebuilt_count);
+
+        mem_free(hpath_graph);
+        hpath_graph = NULL;
+    }
+}
+
+// Marks clusters around tile for rebuild. Called when wall or scenery
+// appears on or disappears from the tile.
+void hpath_invalidate(int tile, int elevation)
+{
+    if (hpath_graph == NULL || hpath_graph->elevation != elevation) {
+        return;
+    }
+
+    if (tile < 0 || tile >= HEX_GRID_SIZE) {
+        return;
+    }
+
+    // Multihex objects also block adjacent tiles which might belong to other
+    // clusters.
+    hpath_graph->clusterDirty[hpath_cluster(tile)] = true;
+    for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+        hpath_graph->clusterDirty[hpath_cluster(tile_num_in_direction(tile, rotation, 1))] = true;
+    }
+
+    hpath_graph->dirty = true;
+}
+
+// Same as `make_path_func`, but routes longer than `HPATH_MIN_DISTANCE` are
+// planned over cluster graph, which is not limited by number of explored
+// tiles. When planner fails (area is disconnected in the graph, or crossing
+// turns out to be blocked by critters), falls back to `make_path_func`.
+//
+// Planned route is not necessarily the shortest one, but it's within a few
+// hexes of it.
+int hpath_make_path(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback)
+{
+    PROFILE_ZONE("path");
+
+    if (hpath_distance(from, to) > HPATH_MIN_DISTANCE) {
+        if (a5) {
+            if (callback(object, to, object->elevation) != NULL) {
+                return 0;
+            }
+        }
+
+        if (hpath_prepare(object->elevation)) {
+            unsigned short waypoints[HPATH_WAYPOINT_CAPACITY];
+            int waypointCount = hpath_find(from, to, waypoints);
+            if (waypointCount > 0) {
+                int length = hpath_refine(object, from, waypoints, waypointCount, rotations, callback);
+                if (length > 0) {
+                    hpath_planned_count++;
+                    return length;
+                }
+            }
+        }
+
+        hpath_fallback_count++;
+    }
+
+    return make_path_func(object, from, to, rotations, a5, callback);
+}
+
+// Builds graph for elevation (or rebuilds dirty clusters).
+static bool hpath_prepare(int elevation)
+{
+    if (hpath_graph == NULL) {
+        hpath_graph = (HPathGraph*)mem_malloc(sizeof(*hpath_graph));
+        if (hpath_graph == NULL) {
+            return false;
+        }
+
+        hpath_graph->elevation = -1;
+        hpath_graph->generation = 0;
+    }
+
+    if (hpath_graph->elevation != elevation) {
+        hpath_graph->elevation = elevation;
+        hpath_graph->dirty = true;
+        for (int cluster = 0; cluster < HPATH_CLUSTER_COUNT; cluster++) {
+            hpath_graph->clusterDirty[cluster] = true;
+        }
+    }
+
+    if (!hpath_graph->dirty) {
+        return true;
+    }
+
+    // Edges of neighbouring clusters point to components of dirty ones, so
+    // they have to be rebuilt too.
+    bool edgesDirty[HPATH_CLUSTER_COUNT];
+    memset(edgesDirty, 0, sizeof(edgesDirty));
+
+    for (int cluster = 0; cluster < HPATH_CLUSTER_COUNT; cluster++) {
+        if (!hpath_graph->clusterDirty[cluster]) {
+            continue;
+        }
+
+        hpath_build_components(cluster);
+        hpath_rebuilt_count++;
+
+        int column = cluster % HPATH_CLUSTER_COLUMNS;
+        int row = cluster / HPATH_CLUSTER_COLUMNS;
+        for (int y = row - 1; y <= row + 1; y++) {
+            for (int x = column - 1; x <= column + 1; x++) {
+                if (x >= 0 && x < HPATH_CLUSTER_COLUMNS && y >= 0 && y < HPATH_CLUSTER_ROWS) {
+                    edgesDirty[y * HPATH_CLUSTER_COLUMNS + x] = true;
+                }
+            }
+        }
+
+        hpath_graph->clusterDirty[cluster] = false;
+    }
+
+    for (int cluster = 0; cluster < HPATH_CLUSTER_COUNT; cluster++) {
+        if (edgesDirty[cluster]) {
+            hpath_build_edges(cluster);
+        }
+    }
+
+    hpath_graph->dirty = false;
+
+    return true;
+}
+
+// Splits open tiles of cluster into connected areas.
+static void hpath_build_components(int cluster)
+{
+    int elevation = hpath_graph->elevation;
+    int left = (cluster % HPATH_CLUSTER_COLUMNS) * HPATH_CLUSTER_SIZE;
+    int top = (cluster / HPATH_CLUSTER_COLUMNS) * HPATH_CLUSTER_SIZE;
+
+    for (int y = top; y < top + HPATH_CLUSTER_SIZE; y++) {
+        for (int x = left; x < left + HPATH_CLUSTER_SIZE; x++) {
+            int tile = y * HEX_GRID_WIDTH + x;
+            hpath_graph->component[tile] = obj_static_blocking_at(tile, elevation)
+                ? HPATH_NO_COMPONENT
+                : HPATH_LOST_COMPONENT;
+        }
+    }
+
+    int componentCount = 0;
+    int stack[HPATH_CLUSTER_AREA];
+
+    for (int y = top; y < top + HPATH_CLUSTER_SIZE; y++) {
+        for (int x = left; x < left + HPATH_CLUSTER_SIZE; x++) {
+            int tile = y * HEX_GRID_WIDTH + x;
+            if (hpath_graph->component[tile] != HPATH_LOST_COMPONENT) {
+                continue;
+            }
+
+            if (componentCount == HPATH_COMPONENT_MAX) {
+                break;
+            }
+
+            // Every tile is pushed once, when it's labeled.
+            int stackSize = 0;
+            stack[stackSize++] = tile;
+            hpath_graph->component[tile] = componentCount;
+
+            while (stackSize != 0) {
+                int current = stack[--stackSize];
+                for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+                    int neighbour = tile_num_in_direction(current, rotation, 1);
+                    if (neighbour != current
+                        && hpath_cluster(neighbour) == cluster
+                        && hpath_graph->component[neighbour] == HPATH_LOST_COMPONENT) {
+                        hpath_graph->component[neighbour] = componentCount;
+                        stack[stackSize++] = neighbour;
+                    }
+                }
+            }
+
+            componentCount++;
+        }
+    }
+
+    hpath_graph->componentCount[cluster] = componentCount;
+}
+
+// Connects areas of cluster to adjacent areas of neighbouring clusters.
+static void hpath_build_edges(int cluster)
+{
+    int left = (cluster % HPATH_CLUSTER_COLUMNS) * HPATH_CLUSTER_SIZE;
+    int top = (cluster / HPATH_CLUSTER_COLUMNS) * HPATH_CLUSTER_SIZE;
+    int center = hpath_cluster_center(cluster);
+    int score[HPATH_COMPONENT_MAX][HPATH_EDGE_MAX];
+
+    for (int component = 0; component < HPATH_COMPONENT_MAX; component++) {
+        hpath_graph->nodes[cluster * HPATH_COMPONENT_MAX + component].edgeCount = 0;
+    }
+
+    for (int y = top; y < top + HPATH_CLUSTER_SIZE; y++) {
+        for (int x = left; x < left + HPATH_CLUSTER_SIZE; x++) {
+            int tile = y * HEX_GRID_WIDTH + x;
+            int component = hpath_graph->component[tile];
+            if (component >= HPATH_COMPONENT_MAX) {
+                continue;
+            }
+
+            HPathNode* node = &(hpath_graph->nodes[cluster * HPATH_COMPONENT_MAX + component]);
+
+            for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+                int neighbour = tile_num_in_direction(tile, rotation, 1);
+                if (neighbour == tile) {
+                    continue;
+                }
+
+                int neighbourCluster = hpath_cluster(neighbour);
+                if (neighbourCluster == cluster) {
+                    continue;
+                }
+
+                int neighbourNode = hpath_node(neighbour);
+                if (neighbourNode == -1) {
+                    continue;
+                }
+
+                // Prefer crossing in the middle of the border.
+                int crossingScore = hpath_distance(tile, center) + hpath_distance(neighbour, hpath_cluster_center(neighbourCluster));
+
+                int index;
+                for (index = 0; index < node->edgeCount; index++) {
+                    if (node->edges[index].node == neighbourNode) {
+                        break;
+                    }
+                }
+
+                if (index == node->edgeCount) {
+                    if (node->edgeCount == HPATH_EDGE_MAX) {
+                        continue;
+                    }
+
+                    node->edgeCount++;
+                } else if (crossingScore >= score[component][index]) {
+                    continue;
+                }
+
+                node->edges[index].node = neighbourNode;
+                node->edges[index].tile = neighbour;
+                score[component][index] = crossingScore;
+            }
+        }
+    }
+}
+
+// Finds route in graph, returns number of waypoints (crossings between
+// clusters followed by `to`) or 0 if there is no route.
+static int hpath_find(int from, int to, unsigned short* waypoints)
+{
+    int start = hpath_node(from);
+    int goal = hpath_node(to);
+    if (start == -1 || goal == -1) {
+        return 0;
+    }
+
+    hpath_graph->generation++;
+    if (hpath_graph->generation == 0) {
+        memset(hpath_graph->seen, 0, sizeof(hpath_graph->seen));
+        memset(hpath_graph->closed, 0, sizeof(hpath_graph->closed));
+        hpath_graph->generation = 1;
+    }
+
+    unsigned short generation = hpath_graph->generation;
+
+    hpath_graph->openCount = 0;
+    hpath_graph->seen[start] = generation;
+    hpath_graph->cost[start] = 0;
+    hpath_graph->parent[start] = start;
+    hpath_graph->entry[start] = from;
+    hpath_open_push(start, hpath_distance(from, to));
+
+    bool found = false;
+    while (hpath_graph->openCount != 0) {
+        int current = hpath_open_pop();
+        if (hpath_graph->closed[current] == generation) {
+            continue;
+        }
+
+        if (current == goal) {
+            found = true;
+            break;
+        }
+
+        hpath_graph->closed[current] = generation;
+
+        HPathNode* node = &(hpath_graph->nodes[current]);
+        int entry = hpath_graph->entry[current];
+        for (int index = 0; index < node->edgeCount; index++) {
+            HPathEdge* edge = &(node->edges[index]);
+            if (hpath_graph->closed[edge->node] == generation) {
+                continue;
+            }
+
+            int cost = hpath_graph->cost[current] + hpath_distance(entry, edge->tile);
+            if (hpath_graph->seen[edge->node] == generation && cost >= hpath_graph->cost[edge->node]) {
+                continue;
+            }
+
+            hpath_graph->seen[edge->node] = generation;
+            hpath_graph->cost[edge->node] = cost;
+            hpath_graph->parent[edge->node] = current;
+            hpath_graph->entry[edge->node] = edge->tile;
+
+            if (!hpath_open_push(edge->node, cost + hpath_distance(edge->tile, to))) {
+                return 0;
+            }
+        }
+    }
+
+    if (!found) {
+        return 0;
+    }
+
+    int count = 0;
+    for (int current = goal; current != start; current = hpath_graph->parent[current]) {
+        count++;
+    }
+
+    // Leave room for `to`.
+    if (count + 1 > HPATH_WAYPOINT_CAPACITY) {
+        return 0;
+    }
+
+    int index = count;
+    waypoints[index] = to;
+    for (int current = goal; current != start; current = hpath_graph->parent[current]) {
+        waypoints[--index] = hpath_graph->entry[current];
+    }
+
+    return count + 1;
+}
+
+// Builds actual path through waypoints. Critter heads to the farthest
+// waypoint within `HPATH_REFINE_DISTANCE`, so local searches stay small and
+// path doesn't zigzag through crossings.
+static int hpath_refine(Object* object, int from, unsigned short* waypoints, int waypointCount, unsigned char* rotations, PathBuilderCallback* callback)
+{
+    int current = from;
+    int length = 0;
+    int index = 0;
+
+    while (index < waypointCount && length < HPATH_PATH_LENGTH) {
+        int next = index;
+        while (next + 1 < waypointCount && hpath_distance(current, waypoints[next + 1]) <= HPATH_REFINE_DISTANCE) {
+            next++;
+        }
+
+        // Don't head to crossing occupied by critter or door, `make_path_func`
+        // never checks destination.
+        while (next + 1 < waypointCount && callback(object, waypoints[next], object->elevation) != NULL) {
+            next++;
+        }
+
+        int target = waypoints[next];
+        int segmentLength = make_path_func(object, current, target, hpath_segment, 0, callback);
+        if (segmentLength == 0) {
+            return 0;
+        }
+
+        if (segmentLength > HPATH_PATH_LENGTH - length) {
+            segmentLength = HPATH_PATH_LENGTH - length;
+        }
+
+        if (rotations != NULL) {
+            memcpy(rotations + length, hpath_segment, segmentLength);
+        }
+
+        length += segmentLength;
+        current = target;
+        index = next + 1;
+    }
+
+    return length;
+}
+
+static bool hpath_open_push(int node, int cost)
+{
+    if (hpath_graph->openCount == HPATH_OPEN_CAPACITY) {
+        return false;
+    }
+
+    HPathOpenNode* open = hpath_graph->open;
+    int index = hpath_graph->openCount++;
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (open[parent].cost <= cost) {
+            break;
+        }
+
+        open[index] = open[parent];
+        index = parent;
+    }
+
+    open[index].cost = cost;
+    open[index].node = node;
+
+    return true;
+}
+
+static int hpath_open_pop()
+{
+    HPathOpenNode* open = hpath_graph->open;
+    int node = open[0].node;
+    HPathOpenNode last = open[--hpath_graph->openCount];
+
+    int index = 0;
+    for (;;) {
+        int child = index * 2 + 1;
+        if (child >= hpath_graph->openCount) {
+            break;
+        }
+
+        if (child + 1 < hpath_graph->openCount && open[child + 1].cost < open[child].cost) {
+            child++;
+        }
+
+        if (last.cost <= open[child].cost) {
+            break;
+        }
+
+        open[index] = open[child];
+        index = child;
+    }
+
+    open[index] = last;
+
+    return node;
+}
+
+static inline int hpath_cluster(int tile)
+{
+    int x = tile % HEX_GRID_WIDTH;
+    int y = tile / HEX_GRID_WIDTH;
+    return (y / HPATH_CLUSTER_SIZE) * HPATH_CLUSTER_COLUMNS + x / HPATH_CLUSTER_SIZE;
+}
+
+static int hpath_cluster_center(int cluster)
+{
+    int x = (cluster % HPATH_CLUSTER_COLUMNS) * HPATH_CLUSTER_SIZE + HPATH_CLUSTER_SIZE / 2;
+    int y = (cluster / HPATH_CLUSTER_COLUMNS) * HPATH_CLUSTER_SIZE + HPATH_CLUSTER_SIZE / 2;
+    return y * HEX_GRID_WIDTH + x;
+}
+
+// Returns graph node of tile, or -1 if tile is blocked or unreachable.
+static inline int hpath_node(int tile)
+{
+    int component = hpath_graph->component[tile];
+    if (component >= HPATH_COMPONENT_MAX) {
+        return -1;
+    }
+
+    return hpath_cluster(tile) * HPATH_COMPONENT_MAX + component;
+}
+
+// Returns number of steps between tiles on the empty grid. Same as
+// `tile_dist`, but without walking the path.
+static int hpath_distance(int tile1, int tile2)
+{
+    int x1 = tile1 % HEX_GRID_WIDTH;
+    int y1 = tile1 / HEX_GRID_WIDTH;
+    int x2 = tile2 % HEX_GRID_WIDTH;
+    int y2 = tile2 / HEX_GRID_WIDTH;
+
+    // Convert to axial coordinates, odd columns are shifted up.
+    int dq = x2 - x1;
+    int dr = (y2 - (x2 + 1) / 2) - (y1 - (x1 + 1) / 2);
+
+    int ds = -dq - dr;
+    if (dq < 0) {
+        dq = -dq;
+    }
+    if (dr < 0) {
+        dr = -dr;
+    }
+    if (ds < 0) {
+        ds = -ds;
+    }
+
+    return (dq + dr + ds) / 2;
+}
+
+} // namespace fallout
@@ -0,0 +1,20 @@
+#ifndef FALLOUT_GAME_HPATH_H_
+#define FALLOUT_GAME_HPATH_H_
+
+#include "game/anim.h"
+#include "game/object_types.h"
+
+namespace fallout {
+
+// CE: Routes longer than this (in hexes) are planned over cluster graph
+// first (see `hpath_make_path`).
+#define HPATH_MIN_DISTANCE 24
+
+void hpath_reset();
+void hpath_exit();
+void hpath_invalidate(int tile, int elevation);
+int hpath_make_path(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback);
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_HPATH_H_ */
@@ -1,17 +1,60 @@
 #include "game/light.h"
 
+#include <string.h>
+
 #include "game/map_defs.h"
 #include "game/object.h"
 #include "game/perk.h"
 #include "game/tile.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/memory.h"
 
 namespace fallout {
 
 // 0x5057E0
 static int ambient_light = LIGHT_LEVEL_MAX;
 
+// CE: Light level of tiles without any light sources.
+#define LIGHT_TILE_BASE 655
+
+static void light_free_tiles();
+static void light_free_snapshot();
+static int* light_tiles(int elevation);
+
+// CE: Per-elevation light map, allocated when elevation receives light for the
+// first time, otherwise all its tiles have `LIGHT_TILE_BASE` light level. Maps
+// are freed on reset and when rebuild leaves elevation unlit.
+//
 // 0x59CF1C
-static int tile_intensity[ELEVATION_COUNT][HEX_GRID_SIZE];
+static int* tile_intensity[ELEVATION_COUNT];
+
+// CE: Bounds (in hex grid coordinates) of tiles which light was changed since
+// the last `light_flush`. Light sources update hundreds of tiles at once,
+// floor cache is invalidated once per batch rather than per tile.
+typedef struct LightDirtyBounds {
+    bool dirty;
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+} LightDirtyBounds;
+
+static void light_mark_dirty(int elevation, int tile);
+
+static LightDirtyBounds light_dirty[ELEVATION_COUNT];
+
+// CE: Light map of elevation being rebuilt as it was before rebuild (see
+// `light_rebuild_begin`). Maps are swapped rather than copied, so the buffer
+// is kept for reuse by the next rebuild.
+static int* light_snapshot = NULL;
+static bool light_snapshot_valid = false;
+
+// CE: Elevation being rebuilt, -1 if none.
+static int light_rebuild_elevation = -1;
+
+// CE: Changes made during rebuild are not tracked (there was no memory for
+// snapshot), whole elevation is considered changed.
+static bool light_rebuild_untracked = false;
 
 // 0x46CA70
 int light_init()
@@ -30,6 +73,8 @@ void light_reset()
 void light_exit()
 {
     light_reset_tiles();
+    light_free_tiles();
+    light_free_snapshot();
 }
 
 // 0x46CA78
@@ -57,6 +102,10 @@ void light_set_ambient(int new_ambient_light, bool refresh_screen)
     old_ambient_light = ambient_light;
     ambient_light = normalized;
 
+    if (old_ambient_light != normalized) {
+        tile_floor_cache_invalidate(-1);
+    }
+
     if (refresh_screen) {
         if (old_ambient_light != normalized) {
             tile_refresh_display();
@@ -89,7 +138,9 @@ int light_get_tile(int elevation, int tile)
         return 0;
     }
 
-    intensity = tile_intensity[elevation][tile];
+    intensity = tile_intensity[elevation] != NULL
+        ? tile_intensity[elevation][tile]
+        : LIGHT_TILE_BASE;
     if (intensity >= LIGHT_LEVEL_MAX) {
         intensity = LIGHT_LEVEL_MAX;
     }
@@ -108,6 +159,10 @@ int light_get_tile_true(int elevation, int tile)
         return 0;
     }
 
+    if (tile_intensity[elevation] == NULL) {
+        return LIGHT_TILE_BASE;
+    }
+
     return tile_intensity[elevation][tile];
 }
 
@@ -122,7 +177,13 @@ void light_set_tile(int elevation, int tile, int lightIntensity)
         return;
     }
 
-    tile_intensity[elevation][tile] = lightIntensity;
+    int* tiles = light_tiles(elevation);
+    if (tiles == NULL) {
+        return;
+    }
+
+    tiles[tile] = lightIntensity;
+    light_mark_dirty(elevation, tile);
 }
 
 // 0x46CB78
@@ -136,7 +197,13 @@ void light_add_to_tile(int elevation, int tile, int lightIntensity)
         return;
     }
 
-    tile_intensity[elevation][tile] += lightIntensity;
+    int* tiles = light_tiles(elevation);
+    if (tiles == NULL) {
+        return;
+    }
+
+    tiles[tile] += lightIntensity;
+    light_mark_dirty(elevation, tile);
 }
 
 // 0x46CBB0
@@ -150,19 +217,241 @@ void light_subtract_from_tile(int elevation, int tile, int lightIntensity)
         return;
     }
 
-    tile_intensity[elevation][tile] -= lightIntensity;
+    int* tiles = light_tiles(elevation);
+    if (tiles == NULL) {
+        return;
+    }
+
+    tiles[tile] -= lightIntensity;
+    light_mark_dirty(elevation, tile);
 }
 
 // 0x46CBEC
 void light_reset_tiles()
 {
     int elevation;
-    int tile;
+
+    // CE: Elevations lit on the next map allocate their maps again.
+    light_free_tiles();
 
     for (elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
-        for (tile = 0; tile < HEX_GRID_SIZE; tile++) {
-            tile_intensity[elevation][tile] = 655;
+        light_dirty[elevation].dirty = false;
+    }
+
+    tile_floor_cache_invalidate(-1);
+}
+
+static void light_free_tiles()
+{
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        if (tile_intensity[elevation] != NULL) {
+            mem_free(tile_intensity[elevation]);
+            tile_intensity[elevation] = NULL;
+        }
+    }
+}
+
+static void light_free_snapshot()
+{
+    if (light_snapshot != NULL) {
+        mem_free(light_snapshot);
+        light_snapshot = NULL;
+    }
+}
+
+// Returns light map of `elevation`, allocating it if needed.
+static int* light_tiles(int elevation)
+{
+    if (tile_intensity[elevation] == NULL) {
+        int* tiles;
+        if (light_snapshot != NULL && !light_snapshot_valid) {
+            // Rebuild buffer is not in use.
+            tiles = light_snapshot;
+            light_snapshot = NULL;
+        } else {
+            tiles = (int*)mem_malloc(sizeof(*tiles) * HEX_GRID_SIZE);
+            if (tiles == NULL) {
+                return NULL;
+            }
+        }
+
+        int value = LIGHT_TILE_BASE;
+        for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+            tiles[tile] = value;
+        }
+
+        tile_intensity[elevation] = tiles;
+
+        int allocated = 0;
+        for (int index = 0; index < ELEVATION_COUNT; index++) {
+            if (tile_intensity[index] != NULL) {
+                allocated++;
+            }
+        }
+
+        // Rebuild buffer counts as well.
+        if (light_snapshot != NULL) {
+            allocated++;
+        }
+
+        // Original map was a static array for all elevations.
+        debug_printf("light: elevation %d light map allocated, %d bytes in use (%d bytes saved)\n",
+            elevation,
+            (int)(sizeof(*tiles) * HEX_GRID_SIZE * allocated),
+            (int)(sizeof(*tiles) * HEX_GRID_SIZE * (ELEVATION_COUNT - allocated)));
+    }
+
+    return tile_intensity[elevation];
+}
+
+static void light_mark_dirty(int elevation, int tile)
+{
+    // Rebuild reports changed tiles when it's done.
+    if (elevation == light_rebuild_elevation) {
+        return;
+    }
+
+    int x = tile % HEX_GRID_WIDTH;
+    int y = tile / HEX_GRID_WIDTH;
+
+    LightDirtyBounds* bounds = &(light_dirty[elevation]);
+    if (bounds->dirty) {
+        if (x < bounds->minX) {
+            bounds->minX = x;
+        } else if (x > bounds->maxX) {
+            bounds->maxX = x;
+        }
+
+        if (y < bounds->minY) {
+            bounds->minY = y;
+        } else if (y > bounds->maxY) {
+            bounds->maxY = y;
+        }
+    } else {
+        bounds->dirty = true;
+        bounds->minX = x;
+        bounds->minY = y;
+        bounds->maxX = x;
+        bounds->maxY = y;
+    }
+}
+
+// CE: Applies light changes made since the last call to floor cache. Screen
+// position of hex is monotonic in both grid coordinates, so corners of
+// changed area are enough to cover it.
+void light_flush()
+{
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        LightDirtyBounds* bounds = &(light_dirty[elevation]);
+        if (!bounds->dirty) {
+            continue;
+        }
+
+        tile_floor_cache_invalidate_tile(elevation, bounds->minY * HEX_GRID_WIDTH + bounds->minX);
+        tile_floor_cache_invalidate_tile(elevation, bounds->minY * HEX_GRID_WIDTH + bounds->maxX);
+        tile_floor_cache_invalidate_tile(elevation, bounds->maxY * HEX_GRID_WIDTH + bounds->minX);
+        tile_floor_cache_invalidate_tile(elevation, bounds->maxY * HEX_GRID_WIDTH + bounds->maxX);
+
+        bounds->dirty = false;
+    }
+}
+
+// CE: Starts rebuilding light map of `elevation` from scratch. Current map
+// is kept aside, so `light_rebuild_end` can report (and invalidate) only tiles
+// which light actually changed instead of the whole map. Returns -1 if there
+// is not enough memory to keep it, the map is reset anyway and whole
+// elevation should be considered changed.
+int light_rebuild_begin(int elevation)
+{
+    if (light_rebuild_elevation != -1 || !elevationIsValid(elevation)) {
+        return -1;
+    }
+
+    light_rebuild_elevation = elevation;
+    light_rebuild_untracked = false;
+    light_snapshot_valid = false;
+
+    int* tiles = tile_intensity[elevation];
+    if (tiles == NULL) {
+        // Base light level everywhere.
+        return 0;
+    }
+
+    if (light_snapshot == NULL) {
+        light_snapshot = (int*)mem_malloc(sizeof(*light_snapshot) * HEX_GRID_SIZE);
+    }
+
+    int value = LIGHT_TILE_BASE;
+
+    if (light_snapshot == NULL) {
+        for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+            tiles[tile] = value;
+        }
+
+        light_rebuild_untracked = true;
+        return -1;
+    }
+
+    for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+        light_snapshot[tile] = value;
+    }
+
+    tile_intensity[elevation] = light_snapshot;
+    light_snapshot = tiles;
+    light_snapshot_valid = true;
+
+    return 0;
+}
+
+// CE: Finishes rebuild started with `light_rebuild_begin`, `proc` (if any) is
+// called for every tile which light has changed.
+void light_rebuild_end(LightChangedTileProc* proc)
+{
+    int elevation = light_rebuild_elevation;
+    if (elevation == -1) {
+        return;
+    }
+
+    light_rebuild_elevation = -1;
+
+    int* tiles = tile_intensity[elevation];
+    int* snapshot = light_snapshot_valid ? light_snapshot : NULL;
+    light_snapshot_valid = false;
+    int value = LIGHT_TILE_BASE;
+
+    if (tiles == NULL) {
+        // Was not lit before rebuild and is not lit now.
+        return;
+    }
+
+    if (light_rebuild_untracked) {
+        tile_floor_cache_invalidate(elevation);
+    }
+
+    // Elevation which was not lit before rebuild has base light level
+    // everywhere.
+    bool lit = false;
+    for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+        if (tiles[tile] != value) {
+            lit = true;
+        }
+
+        if (!light_rebuild_untracked && tiles[tile] != (snapshot != NULL ? snapshot[tile] : value)) {
+            light_mark_dirty(elevation, tile);
+
+            if (proc != NULL) {
+                proc(elevation, tile);
+            }
+        }
+    }
+
+    if (!lit) {
+        if (light_snapshot == NULL) {
+            light_snapshot = tiles;
+        } else {
+            mem_free(tiles);
         }
+        tile_intensity[elevation] = NULL;
     }
 }
 
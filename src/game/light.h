@@ -10,6 +10,7 @@ namespace fallout {
 #define LIGHT_LEVEL_NIGHT_VISION_BONUS (LIGHT_LEVEL_MAX / 10)
 
 typedef void(AdjustLightIntensityProc)(int elevation, int tile, int intensity);
+typedef void(LightChangedTileProc)(int elevation, int tile);
 
 int light_init();
 void light_reset();
@@ -24,6 +25,9 @@ void light_set_tile(int elevation, int tile, int intensity);
 void light_add_to_tile(int elevation, int tile, int intensity);
 void light_subtract_from_tile(int elevation, int tile, int intensity);
 void light_reset_tiles();
+int light_rebuild_begin(int elevation);
+void light_rebuild_end(LightChangedTileProc* proc);
+void light_flush();
 
 } // namespace fallout
 
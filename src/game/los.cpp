@@ -0,0 +1,336 @@
+#include "game/los.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "game/anim.h"
+#include "game/object.h"
+#include "game/tile.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/profile.h"
+
+namespace fallout {
+
+// CE: Shot blocking queries.
+//
+// `combat_is_shot_blocked` asks `make_straight_path` for the first obstacle
+// on the line between two tiles. Most of its time is spent stepping along
+// the line pixel by pixel and converting every pixel back to tile, while the
+// sequence of tiles it checks only depends on line ends. These sequences are
+// cached, so repeated queries (AI evaluates the same pairs many times per
+// turn) only check tiles for obstacles.
+//
+// NOTE: Stepping is done in screen coordinates, but `tile_set_center` always
+// keeps `tile_x` even, so scrolling does not change tiles of the line.
+
+#define LOS_CACHE_SIZE 1024
+
+// Lines checking more tiles are not cached.
+#define LOS_LINE_LENGTH 64
+
+// Number of entries in obstacle memo of `los_shot_blocked_many`.
+#define LOS_MEMO_SIZE 512
+
+typedef struct LosLine {
+    int from;
+    int to;
+    int elevation;
+
+    // Number of tiles checked along the line.
+    int length;
+
+    // Line is too long for `make_straight_path_func`, it gives up after
+    // checking `length` tiles without reporting anything.
+    bool truncated;
+
+    unsigned short tiles[LOS_LINE_LENGTH];
+} LosLine;
+
+typedef struct LosMemoEntry {
+    unsigned int generation;
+    int tile;
+    Object* obstacle;
+} LosMemoEntry;
+
+static LosLine* los_line(int from, int to, int elevation);
+static bool los_build(int from, int to, int elevation, LosLine* line);
+static Object* los_blocking_at(Object* a1, int tile, int elevation);
+static void los_obstacle(Object* a1, int from, int to, Object** obstaclePtr);
+static bool los_blocked(Object* a1, int from, int to, Object* a4, int* a5);
+
+static LosLine los_cache[LOS_CACHE_SIZE];
+static bool los_cache_initialized = false;
+
+// Obstacles found during `los_shot_blocked_many`, all of its queries are
+// made on behalf of the same object, so `obj_blocking_at` results can be
+// shared between lines.
+static LosMemoEntry los_memo[LOS_MEMO_SIZE];
+static unsigned int los_memo_generation = 0;
+static bool los_memo_enabled = false;
+
+static int los_hits = 0;
+static int los_misses = 0;
+
+void los_exit()
+{
+    if (los_hits + los_misses != 0) {
+        debug_printf("los: %d cached lines used, %d lines built\n", los_hits, los_misses);
+    }
+
+    los_cache_initialized = false;
+}
+
+// Same as `make_straight_path(a1, from, to, NULL, obstaclePtr, 32)`.
+void los_straight_obstacle(Object* a1, int from, int to, Object** obstaclePtr)
+{
+    PROFILE_ZONE("los");
+
+    los_obstacle(a1, from, to, obstaclePtr);
+}
+
+// Same as `combat_is_shot_blocked`.
+bool los_shot_blocked(Object* a1, int from, int to, Object* a4, int* a5)
+{
+    PROFILE_ZONE("los");
+
+    return los_blocked(a1, from, to, a4, a5);
+}
+
+// Checks shots from `a1` to every target, results are the same as of
+// `combat_is_shot_blocked(a1, a1->tile, target->tile, target, NULL)`.
+void los_shot_blocked_many(Object* a1, Object** targets, int count, bool* blocked)
+{
+    PROFILE_ZONE("los");
+
+    los_memo_generation++;
+    if (los_memo_generation == 0) {
+        memset(los_memo, 0, sizeof(los_memo));
+        los_memo_generation = 1;
+    }
+
+    los_memo_enabled = true;
+
+    for (int index = 0; index < count; index++) {
+        blocked[index] = los_blocked(a1, a1->tile, targets[index]->tile, targets[index], NULL);
+    }
+
+    los_memo_enabled = false;
+}
+
+// Returns cached line, building it if needed, or `NULL` if line is too long
+// to be cached.
+static LosLine* los_line(int from, int to, int elevation)
+{
+    if (!los_cache_initialized) {
+        for (int index = 0; index < LOS_CACHE_SIZE; index++) {
+            los_cache[index].from = -1;
+        }
+        los_cache_initialized = true;
+    }
+
+    unsigned int hash = (unsigned int)from * 2654435761u ^ (unsigned int)to * 40503u;
+    LosLine* line = &(los_cache[(hash >> 8) % LOS_CACHE_SIZE]);
+    if (line->from == from && line->to == to && line->elevation == elevation) {
+        los_hits++;
+        return line;
+    }
+
+    los_misses++;
+
+    if (!los_build(from, to, elevation, line)) {
+        line->from = -1;
+        return NULL;
+    }
+
+    line->from = from;
+    line->to = to;
+    line->elevation = elevation;
+
+    return line;
+}
+
+// Records tiles checked by `make_straight_path_func` (with `a6` of 32 and no
+// path nodes) on its way from `from` to `to`. Stepping must be kept in sync
+// with it.
+static bool los_build(int from, int to, int elevation, LosLine* line)
+{
+    line->length = 0;
+    line->truncated = false;
+
+    int fromX;
+    int fromY;
+    tile_coord(from, &fromX, &fromY, elevation);
+    fromX += 16;
+    fromY += 8;
+
+    int toX;
+    int toY;
+    tile_coord(to, &toX, &toY, elevation);
+    toX += 16;
+    toY += 8;
+
+    int stepX;
+    int deltaX = toX - fromX;
+    if (deltaX > 0)
+        stepX = 1;
+    else if (deltaX < 0)
+        stepX = -1;
+    else
+        stepX = 0;
+
+    int stepY;
+    int deltaY = toY - fromY;
+    if (deltaY > 0)
+        stepY = 1;
+    else if (deltaY < 0)
+        stepY = -1;
+    else
+        stepY = 0;
+
+    int v48 = 2 * abs(toX - fromX);
+    int v47 = 2 * abs(toY - fromY);
+
+    int tileX = fromX;
+    int tileY = fromY;
+
+    int pathNodeIndex = 0;
+    int prevTile = from;
+    int v22 = 0;
+    int tile;
+
+    bool major = v48 <= v47;
+    int middle = major ? v48 - v47 / 2 : v47 - v48 / 2;
+    while (true) {
+        tile = tile_num(tileX, tileY, elevation);
+
+        v22 += 1;
+        if (v22 == 32) {
+            if (pathNodeIndex >= 200) {
+                line->truncated = true;
+                return true;
+            }
+
+            v22 = 0;
+            pathNodeIndex++;
+        }
+
+        if (major) {
+            if (tileY == toY) {
+                break;
+            }
+
+            if (middle >= 0) {
+                tileX += stepX;
+                middle -= v47;
+            }
+
+            tileY += stepY;
+            middle += v48;
+        } else {
+            if (tileX == toX) {
+                break;
+            }
+
+            if (middle >= 0) {
+                tileY += stepY;
+                middle -= v48;
+            }
+
+            tileX += stepX;
+            middle += v47;
+        }
+
+        if (tile != prevTile) {
+            // Tiles outside of the map never block.
+            if (tile != -1) {
+                if (line->length == LOS_LINE_LENGTH) {
+                    return false;
+                }
+
+                line->tiles[line->length++] = tile;
+            }
+            prevTile = tile;
+        }
+    }
+
+    return true;
+}
+
+static Object* los_blocking_at(Object* a1, int tile, int elevation)
+{
+    if (!los_memo_enabled) {
+        return obj_blocking_at(a1, tile, elevation);
+    }
+
+    LosMemoEntry* entry = &(los_memo[(unsigned int)tile % LOS_MEMO_SIZE]);
+    if (entry->generation != los_memo_generation || entry->tile != tile) {
+        entry->generation = los_memo_generation;
+        entry->tile = tile;
+        entry->obstacle = obj_blocking_at(a1, tile, elevation);
+    }
+
+    return entry->obstacle;
+}
+
+// See `los_straight_obstacle`.
+static void los_obstacle(Object* a1, int from, int to, Object** obstaclePtr)
+{
+    Object* obstacle = los_blocking_at(a1, from, a1->elevation);
+    if (obstacle != NULL) {
+        if (obstacle != *obstaclePtr && (obstacle->flags & OBJECT_SHOOT_THRU) == 0) {
+            *obstaclePtr = obstacle;
+            return;
+        }
+    }
+
+    LosLine* line = los_line(from, to, a1->elevation);
+    if (line == NULL) {
+        make_straight_path(a1, from, to, NULL, obstaclePtr, 32);
+        return;
+    }
+
+    for (int index = 0; index < line->length; index++) {
+        obstacle = los_blocking_at(a1, line->tiles[index], a1->elevation);
+        if (obstacle != NULL) {
+            if (obstacle != *obstaclePtr && (obstacle->flags & OBJECT_SHOOT_THRU) == 0) {
+                *obstaclePtr = obstacle;
+                return;
+            }
+        }
+    }
+
+    if (!line->truncated) {
+        *obstaclePtr = NULL;
+    }
+}
+
+// See `combat_is_shot_blocked`.
+static bool los_blocked(Object* a1, int from, int to, Object* a4, int* a5)
+{
+    Object* obstacle = a1;
+
+    if (a5 != NULL) {
+        *a5 = 0;
+    }
+
+    while (obstacle != NULL && from != to) {
+        los_obstacle(a1, from, to, &obstacle);
+        if (obstacle != NULL) {
+            if (FID_TYPE(obstacle->fid) != OBJ_TYPE_CRITTER) {
+                return true;
+            }
+
+            if (a5 != NULL) {
+                if (obstacle != a4) {
+                    *a5 += 1;
+                }
+            }
+
+            from = obstacle->tile;
+        }
+    }
+
+    return false;
+}
+
+} // namespace fallout
@@ -0,0 +1,15 @@
+#ifndef FALLOUT_GAME_LOS_H_
+#define FALLOUT_GAME_LOS_H_
+
+#include "game/object_types.h"
+
+namespace fallout {
+
+void los_exit();
+void los_straight_obstacle(Object* a1, int from, int to, Object** obstaclePtr);
+bool los_shot_blocked(Object* a1, int from, int to, Object* a4, int* a5);
+void los_shot_blocked_many(Object* a1, Object** targets, int count, bool* blocked);
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_LOS_H_ */
@@ -12,9 +12,11 @@
 
 #include <limits.h>
 #include <stddef.h>
+#include <string.h>
 
 #include "game/amutex.h"
 #include "game/art.h"
+#include "game/cbench.h"
 #include "game/credits.h"
 #include "game/cycle.h"
 #include "game/endgame.h"
@@ -36,6 +38,7 @@
 #include "game/selfrun.h"
 #include "game/wordwrap.h"
 #include "game/worldmap.h"
+#include "platform_compat.h"
 #include "plib/color/color.h"
 #include "plib/gnw/debug.h"
 #include "plib/gnw/gnw.h"
@@ -64,6 +67,10 @@ static void main_selfrun_play();
 static void main_death_scene();
 static void main_death_voiceover_callback();
 
+#ifdef FALLOUT_PROFILE
+static bool main_combat_bench();
+#endif
+
 // 0x4F9F70
 static char mainMap[] = "V13Ent.map";
 
@@ -104,6 +111,14 @@ int gnw_main(int argc, char** argv)
     }
     // DbgPrint("gnw_main: main_init_system succeeded\n");
 
+#ifdef FALLOUT_PROFILE
+    if (main_combat_bench()) {
+        main_exit_system();
+        autorun_mutex_destroy();
+        return 0;
+    }
+#endif
+
     // DbgPrint("gnw_main: playing MOVIE_IPLOGO\n");
     //gmovie_play(MOVIE_IPLOGO, GAME_MOVIE_FADE_IN);
 
@@ -339,6 +354,28 @@ static int main_load_new(char* mapFileName)
     return 0;
 }
 
+#ifdef FALLOUT_PROFILE
+// CE: Runs combat benchmark (see `cbench_run`) instead of the main menu when
+// `[debug]combat_bench_map` is set. Returns `false` if it's not set.
+static bool main_combat_bench()
+{
+    char* mapName;
+    if (!config_get_string(&game_config, GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_COMBAT_BENCH_MAP_KEY, &mapName) || mapName[0] == '\0') {
+        return false;
+    }
+
+    char mapFileName[COMPAT_MAX_PATH];
+    strncpy(mapFileName, mapName, sizeof(mapFileName) - 1);
+    mapFileName[sizeof(mapFileName) - 1] = '\0';
+
+    main_load_new(mapFileName);
+    cbench_run();
+    main_unload_new();
+
+    return true;
+}
+#endif
+
 // 0x472A04
 static int main_loadgame_new()
 {
@@ -46,8 +46,6 @@ namespace fallout {
 static int map_age_dead_critters();
 static void map_match_map_number();
 static void map_display_draw(Rect* rect);
-static void map_scroll_refresh_game(Rect* rect);
-static void map_scroll_refresh_mapper(Rect* rect);
 static int map_allocate_global_vars(int count);
 static void map_free_global_vars();
 static int map_load_global_vars(DB_FILE* stream);
@@ -207,9 +205,6 @@ char byte_50B058[] = "";
 // 0x50B30C
 char _aErrorF2[] = "ERROR! F2";
 
-// 0x505ACC
-static IsoWindowRefreshProc* map_scroll_refresh = map_scroll_refresh_game;
-
 // 0x505AD0
 static int map_data_elev_flags[ELEVATION_COUNT] = {
     2,
@@ -372,12 +367,6 @@ void iso_exit()
 // 0x473BD0
 void map_init()
 {
-    char* executable;
-    config_get_string(&game_config, GAME_CONFIG_SYSTEM_KEY, "executable", &executable);
-    if (compat_stricmp(executable, "mapper") == 0) {
-        map_scroll_refresh = map_scroll_refresh_mapper;
-    }
-
     if (message_init(&map_msg_file)) {
         char path[COMPAT_MAX_PATH];
         snprintf(path, sizeof(path), "%smap.msg", msg_path);
@@ -738,76 +727,12 @@ int map_scroll(int dx, int dy)
         return -1;
     }
 
-    if (tile_set_center(newCenterTile, 0) == -1) {
+    // CE: Tile module shifts display contents and renders only exposed
+    // strips.
+    if (tile_set_center(newCenterTile, TILE_SET_CENTER_REFRESH_WINDOW) == -1) {
         return -1;
     }
 
-    Rect r1;
-    rectCopy(&r1, &map_display_rect);
-
-    Rect r2;
-    rectCopy(&r2, &r1);
-
-    int width = scr_size.lrx - scr_size.ulx + 1;
-    int pitch = width;
-    int height = scr_size.lry - scr_size.uly - 99;
-
-    if (screenDx != 0) {
-        width -= 32;
-    }
-
-    if (screenDy != 0) {
-        height -= 24;
-    }
-
-    if (screenDx < 0) {
-        r2.lrx = r2.ulx - screenDx;
-    } else {
-        r2.ulx = r2.lrx - screenDx;
-    }
-
-    unsigned char* src;
-    unsigned char* dest;
-    int step;
-    if (screenDy < 0) {
-        r1.lry = r1.uly - screenDy;
-        src = display_buf + pitch * (height - 1);
-        dest = display_buf + pitch * (scr_size.lry - scr_size.uly - 100);
-        if (screenDx < 0) {
-            dest -= screenDx;
-        } else {
-            src += screenDx;
-        }
-        step = -pitch;
-    } else {
-        r1.uly = r1.lry - screenDy;
-        dest = display_buf;
-        src = display_buf + pitch * screenDy;
-
-        if (screenDx < 0) {
-            dest -= screenDx;
-        } else {
-            src += screenDx;
-        }
-        step = pitch;
-    }
-
-    for (int y = 0; y < height; y++) {
-        memmove(dest, src, width);
-        dest += step;
-        src += step;
-    }
-
-    if (screenDx != 0) {
-        map_scroll_refresh(&r2);
-    }
-
-    if (screenDy != 0) {
-        map_scroll_refresh(&r1);
-    }
-
-    win_draw(display_win);
-
     return 0;
 }
 
@@ -1594,51 +1519,6 @@ static void map_display_draw(Rect* rect)
     win_draw_rect(display_win, rect);
 }
 
-// 0x475C50
-static void map_scroll_refresh_game(Rect* rect)
-{
-    Rect rectToUpdate;
-    if (rect_inside_bound(rect, &map_display_rect, &rectToUpdate) == -1) {
-        return;
-    }
-
-    // CE: Clear dirty rect to prevent most of the visual artifacts near map
-    // edges.
-    buf_fill(display_buf + rectToUpdate.uly * rectGetWidth(&map_display_rect) + rectToUpdate.ulx,
-        rectGetWidth(&rectToUpdate),
-        rectGetHeight(&rectToUpdate),
-        rectGetWidth(&map_display_rect),
-        0);
-
-    square_render_floor(&rectToUpdate, map_elevation);
-    grid_render(&rectToUpdate, map_elevation);
-    obj_render_pre_roof(&rectToUpdate, map_elevation);
-    square_render_roof(&rectToUpdate, map_elevation);
-    bounds_render(&rectToUpdate, map_elevation);
-    obj_render_post_roof(&rectToUpdate, map_elevation);
-}
-
-// 0x475CB0
-static void map_scroll_refresh_mapper(Rect* rect)
-{
-    Rect rectToUpdate;
-    if (rect_inside_bound(rect, &map_display_rect, &rectToUpdate) == -1) {
-        return;
-    }
-
-    buf_fill(display_buf + rectToUpdate.uly * rectGetWidth(&map_display_rect) + rectToUpdate.ulx,
-        rectGetWidth(&rectToUpdate),
-        rectGetHeight(&rectToUpdate),
-        rectGetWidth(&map_display_rect),
-        0);
-
-    square_render_floor(&rectToUpdate, map_elevation);
-    grid_render(&rectToUpdate, map_elevation);
-    obj_render_pre_roof(&rectToUpdate, map_elevation);
-    square_render_roof(&rectToUpdate, map_elevation);
-    obj_render_post_roof(&rectToUpdate, map_elevation);
-}
-
 // 0x475D50
 static int map_allocate_global_vars(int count)
 {
@@ -1759,6 +1639,14 @@ static void square_init()
 // 0x475F78
 static void square_reset()
 {
+    tile_print_stats();
+
+    // Squares are about to change, cached floor and display buffer are no
+    // longer valid.
+    tile_floor_cache_invalidate(-1);
+    tile_roof_regions_invalidate();
+    tile_display_invalidate();
+
     for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
         int* p = square[elevation]->field_0;
         for (int y = 0; y < SQUARE_GRID_HEIGHT; y++) {
@@ -1815,6 +1703,10 @@ static int square_load(DB_FILE* stream, int flags)
         }
     }
 
+    // CE: Label connected roofs once so entering/leaving buildings does not
+    // need flood fill.
+    tile_roof_regions_build();
+
     return 0;
 }
 
@@ -12,6 +12,7 @@
 #include "game/game.h"
 #include "game/gconfig.h"
 #include "game/gmouse.h"
+#include "game/hpath.h"
 #include "game/item.h"
 #include "game/light.h"
 #include "game/map.h"
@@ -27,10 +28,78 @@
 #include "plib/gnw/grbuf.h"
 #include "plib/gnw/input.h"
 #include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
 #include "plib/gnw/svga.h"
 
 namespace fallout {
 
+// CE: Number of cached outline masks.
+#define OUTLINE_MASK_CACHE_SIZE 64
+
+typedef enum OutlineMaskOpType {
+    // Pixel itself (first transparent pixel after opaque run).
+    OUTLINE_MASK_OP_EDGE,
+
+    // Pixel to the left (opaque run starts).
+    OUTLINE_MASK_OP_LEFT,
+
+    // Pixel to the right (row ends with opaque pixel).
+    OUTLINE_MASK_OP_RIGHT,
+
+    // Pixel above (opaque run starts).
+    OUTLINE_MASK_OP_TOP,
+
+    // Pixel below (column ends with opaque pixel).
+    OUTLINE_MASK_OP_BOTTOM,
+} OutlineMaskOpType;
+
+// Single outline write. Coordinates are those of the frame pixel which
+// produced it, they are used for clipping and color cycling.
+typedef struct OutlineMaskOp {
+    short x;
+    short y;
+    unsigned char type;
+} OutlineMaskOp;
+
+// Outline of a single art frame - writes in the order they are applied
+// (horizontal scan followed by vertical scan).
+typedef struct OutlineMask {
+    int fid;
+    int frame;
+    int rotation;
+    int width;
+    int height;
+    unsigned int mru;
+    int count;
+    OutlineMaskOp* ops;
+} OutlineMask;
+
+// CE: Number of blocks allocated at once by `obj_pool_alloc`.
+#define OBJ_POOL_CHUNK_OBJECTS 128
+#define OBJ_POOL_CHUNK_NODES 1024
+
+// CE: Fixed size block allocator for objects and list nodes.
+//
+// Blocks are carved from chunks which are never returned to the heap while
+// any block is in use (dude, egg and party members live through map
+// changes), freed blocks are kept in a list and reused by the next map.
+typedef struct ObjectPool {
+    const char* name;
+    size_t blockSize;
+    int chunkLength;
+
+    // Singly linked list of chunks, first pointer of every chunk is the
+    // next chunk.
+    void* chunks;
+    int chunkCount;
+
+    // Singly linked list of free blocks.
+    void* freeList;
+
+    int used;
+    int peak;
+} ObjectPool;
+
 static int obj_read_obj(Object* obj, DB_FILE* stream);
 static int obj_load_func(DB_FILE* stream);
 static void obj_fix_combat_cid_for_dude();
@@ -53,12 +122,27 @@ static int obj_create_object(Object** objectPtr);
 static void obj_destroy_object(Object** objectPtr);
 static int obj_create_object_node(ObjectListNode** nodePtr);
 static void obj_destroy_object_node(ObjectListNode** nodePtr);
+static void* obj_pool_alloc(ObjectPool* pool);
+static void obj_pool_free(ObjectPool* pool, void* block);
+static void obj_pool_exit(ObjectPool* pool);
 static int obj_node_ptr(Object* obj, ObjectListNode** out_node, ObjectListNode** out_prev_node);
 static void obj_insert(ObjectListNode* ptr);
+static bool obj_blocking_candidate(Object* obj);
+static void obj_blocking_mark(Object* obj);
+static void obj_blocking_unmark(Object* obj);
+static void obj_blocking_refresh(int tile, int elevation);
+static void obj_index_mark(Object* obj);
+static int obj_index_next(int tile, int elevation, int slot);
+static void obj_index_clear(int tile, int elevation, int slot);
+static int obj_index_slot(int objectType);
 static int obj_remove(ObjectListNode* a1, ObjectListNode* a2);
 static int obj_connect_to_tile(ObjectListNode* node, int tile_index, int elev, Rect* rect);
 static int obj_adjust_light(Object* obj, int a2, Rect* rect);
+static void obj_light_changed(int elevation, int tile);
 static void obj_render_outline(Object* object, Rect* rect);
+static OutlineMask* outline_mask_get(int fid, int frame, int rotation, unsigned char* src, int width, int height);
+static int outline_mask_build(unsigned char* src, int width, int height, OutlineMaskOp* ops);
+static void outline_mask_cache_free();
 static void obj_render_object(Object* object, Rect* rect, int light);
 static int obj_preload_sort(const void* a1, const void* a2);
 
@@ -103,6 +187,14 @@ static int outlineCount = 0;
 // 0x505BA0
 static ObjectListNode* floatingObjects = NULL;
 
+// CE: LRU cache of outline masks, see `obj_render_outline`.
+static OutlineMask outline_masks[OUTLINE_MASK_CACHE_SIZE];
+static unsigned int outline_mask_mru = 0;
+
+// CE: See `ObjectPool`.
+static ObjectPool obj_object_pool = { "objects", sizeof(Object), OBJ_POOL_CHUNK_OBJECTS };
+static ObjectPool obj_node_pool = { "nodes", sizeof(ObjectListNode), OBJ_POOL_CHUNK_NODES };
+
 // 0x505BA4
 static int centerToUpperLeft = 0;
 
@@ -219,6 +311,10 @@ static int light_offsets[2][6][36];
 // 0x638150
 static Object* outlinedObjects[100];
 
+// CE: Area affected by light rebuild (see `obj_rebuild_light`).
+static Rect* obj_light_rect = NULL;
+static bool obj_light_rect_valid = false;
+
 // 0x6382E0
 static Rect buf_rect;
 
@@ -227,6 +323,46 @@ static Rect buf_rect;
 // 0x6382F0
 static ObjectListNode* objectTable[HEX_GRID_SIZE];
 
+// CE: Tiles which might be blocked by critter, scenery or wall, one bit per
+// tile (see `obj_blocking_at`).
+//
+// The bit is set for every tile which has such object at given elevation
+// (or adjacent multihex one) regardless of `OBJECT_HIDDEN` and
+// `OBJECT_NO_BLOCK` flags, so clear bit guarantees the tile is free while set
+// bit still needs list walk. Stale bits are cleared when the walk finds no
+// candidates.
+static unsigned char obj_blocking_bits[ELEVATION_COUNT][(HEX_GRID_SIZE + 7) / 8];
+
+// CE: Tiles which might block sight, one bit per tile (see
+// `obj_sight_blocking_at`).
+//
+// Same as `obj_blocking_bits`, but only scenery and walls on the tile itself
+// are taken into account (`OBJECT_HIDDEN` and `OBJECT_LIGHT_THRU` flags are
+// ignored).
+static unsigned char obj_sight_bits[ELEVATION_COUNT][(HEX_GRID_SIZE + 7) / 8];
+
+// CE: Slots of `obj_index_bits`, object types up to `OBJ_TYPE_MISC` have
+// their own slot, `OBJ_INDEX_ANY` is for objects of any type.
+#define OBJ_INDEX_ANY (OBJ_TYPE_MISC + 1)
+#define OBJ_INDEX_SLOT_COUNT (OBJ_INDEX_ANY + 1)
+
+// CE: Tiles which might have objects, one bit per tile, by elevation and
+// `FID_TYPE` (see `obj_index_next`).
+//
+// Enumeration functions still walk `objectTable` in the same order, the
+// bits only let them skip empty tiles. The bits are set when object is
+// inserted and are not updated on removal, so set bit still needs list walk.
+// Stale bits are cleared when the walk finds nothing.
+static unsigned int obj_index_bits[ELEVATION_COUNT][OBJ_INDEX_SLOT_COUNT][(HEX_GRID_SIZE + 31) / 32];
+
+// CE: Incremented whenever result of `obj_blocking_at` might have changed
+// (see `obj_blocking_changed`).
+static unsigned int obj_blocking_serial = 0;
+
+// CE: Same as `obj_blocking_serial`, but only incremented when objects other
+// than critters appear or disappear (see `obj_blocking_static_version`).
+static unsigned int obj_blocking_static_serial = 0;
+
 // 0x65F3F0
 static Rect updateAreaPixelBounds;
 
@@ -387,6 +523,11 @@ void obj_exit()
         obj_order_table_exit();
 
         obj_offset_table_exit();
+
+        outline_mask_cache_free();
+
+        obj_pool_exit(&obj_object_pool);
+        obj_pool_exit(&obj_node_pool);
     }
 }
 
@@ -547,7 +688,9 @@ static int obj_load_func(DB_FILE* stream)
                     }
 
                     if (fixMapInventory) {
-                        inventoryItem->item = (Object*)mem_malloc(sizeof(Object));
+                        // CE: Objects are allocated from pool (see
+                        // `obj_destroy_object`).
+                        obj_create_object(&(inventoryItem->item));
                         if (inventoryItem->item == NULL) {
                             debug_printf("Error loading inventory\n");
                             return -1;
@@ -1121,7 +1264,8 @@ int obj_disconnect(Object* obj, Rect* rect)
     }
 
     if (node != NULL) {
-        mem_free(node);
+        // CE: Nodes are allocated from pool.
+        obj_destroy_object_node(&node);
     }
 
     obj->tile = -1;
@@ -1389,6 +1533,10 @@ int obj_move_to_tile(Object* obj, int tile, int elevation, Rect* rect)
         }
     }
 
+    // CE: Critters leave tiles all the time, clear their bits right away
+    // rather than waiting for the next query.
+    obj_blocking_unmark(obj);
+
     if (obj_connect_to_tile(node, tile, elevation, rect) == -1) {
         return -1;
     }
@@ -1441,16 +1589,38 @@ int obj_move_to_tile(Object* obj, int tile, int elevation, Rect* rect)
             bool isEmpty = art_id(OBJ_TYPE_TILE, 1, 0, 0, 0) == currentSquareFid;
 
             if (isEmpty != obj_last_is_empty || (((currentSquare >> 16) & 0xF000) >> 12) != (((previousSquare >> 16) & 0xF000) >> 12)) {
+                // CE: Refresh only areas of roofs being toggled instead of
+                // the entire screen.
+                Rect roofRect;
+                bool hasRoofRect = false;
+
                 if (!obj_last_is_empty) {
                     tile_fill_roof(obj_last_roof_x, obj_last_roof_y, elevation, true);
+
+                    if (tile_roof_region_rect(obj_last_roof_x, obj_last_roof_y, elevation, &roofRect) != 0) {
+                        roofRect = scr_size;
+                    }
+                    hasRoofRect = true;
                 }
 
                 if (!isEmpty) {
                     tile_fill_roof(roofX, roofY, elevation, false);
+
+                    Rect regionRect;
+                    if (tile_roof_region_rect(roofX, roofY, elevation, &regionRect) != 0) {
+                        regionRect = scr_size;
+                    }
+
+                    if (hasRoofRect) {
+                        rect_min_bound(&roofRect, &regionRect, &roofRect);
+                    } else {
+                        roofRect = regionRect;
+                        hasRoofRect = true;
+                    }
                 }
 
-                if (rect != NULL) {
-                    rect_min_bound(rect, &scr_size, rect);
+                if (rect != NULL && hasRoofRect) {
+                    rect_min_bound(rect, &roofRect, rect);
                 }
             }
 
@@ -1516,6 +1686,10 @@ int obj_change_fid(Object* obj, int fid, Rect* dirtyRect)
         obj->fid = fid;
     }
 
+    // CE: New art might be of blocking type.
+    obj_blocking_mark(obj);
+    obj_index_mark(obj);
+
     return 0;
 }
 
@@ -1690,14 +1864,77 @@ int obj_dec_rotation(Object* obj, Rect* dirtyRect)
 // 0x47C83C
 void obj_rebuild_all_light()
 {
-    light_reset_tiles();
+    obj_rebuild_light(NULL);
+}
 
-    for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
-        ObjectListNode* objectListNode = objectTable[tile];
-        while (objectListNode != NULL) {
-            obj_adjust_light(objectListNode->obj, 0, NULL);
-            objectListNode = objectListNode->next;
+// CE: Recomputes light map from all light sources on the map. Only tiles
+// which light level actually changed are invalidated, `rect` (if given)
+// receives area of the screen (on the current elevation) which needs to be
+// redrawn. Returns -1 if nothing visible has changed.
+//
+// Elevations are rebuilt one by one, so only one light map is kept aside at
+// a time.
+int obj_rebuild_light(Rect* rect)
+{
+    PROFILE_ZONE("light_rebuild");
+
+    obj_light_rect = rect;
+    obj_light_rect_valid = false;
+
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        bool tracked = light_rebuild_begin(elevation) == 0;
+
+        for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+            ObjectListNode* objectListNode = objectTable[tile];
+            while (objectListNode != NULL) {
+                if (objectListNode->obj->elevation == elevation) {
+                    obj_adjust_light(objectListNode->obj, 0, NULL);
+                }
+                objectListNode = objectListNode->next;
+            }
+        }
+
+        light_rebuild_end(rect != NULL ? obj_light_changed : NULL);
+
+        if (!tracked && elevation == map_elevation && rect != NULL) {
+            rectCopy(rect, &scr_size);
+            obj_light_rect_valid = true;
+        }
+    }
+
+    obj_light_rect = NULL;
+
+    return obj_light_rect_valid ? 0 : -1;
+}
+
+// Accumulates screen area affected by light change of `tile` into
+// `obj_light_rect`.
+static void obj_light_changed(int elevation, int tile)
+{
+    if (elevation != map_elevation) {
+        return;
+    }
+
+    Rect rect;
+    if (tile_light_bound(tile, elevation, &rect) != 0) {
+        return;
+    }
+
+    ObjectListNode* objectListNode = objectTable[tile];
+    while (objectListNode != NULL) {
+        if (objectListNode->obj->elevation == elevation) {
+            Rect objectRect;
+            obj_bound(objectListNode->obj, &objectRect);
+            rect_min_bound(&rect, &objectRect, &rect);
         }
+        objectListNode = objectListNode->next;
+    }
+
+    if (obj_light_rect_valid) {
+        rect_min_bound(obj_light_rect, &rect, obj_light_rect);
+    } else {
+        rectCopy(obj_light_rect, &rect);
+        obj_light_rect_valid = true;
     }
 }
 
@@ -1817,6 +2054,7 @@ int obj_turn_on(Object* obj, Rect* rect)
     }
 
     obj->flags &= ~OBJECT_HIDDEN;
+    obj_blocking_changed();
     obj->outline &= ~OUTLINE_DISABLED;
 
     if (obj_adjust_light(obj, 0, rect) == -1) {
@@ -1854,6 +2092,7 @@ int obj_turn_off(Object* object, Rect* rect)
     }
 
     object->flags |= OBJECT_HIDDEN;
+    obj_blocking_changed();
 
     if ((object->outline & OUTLINE_TYPE_MASK) != 0) {
         object->outline |= OUTLINE_DISABLED;
@@ -2091,12 +2330,15 @@ Object* obj_find_first()
 {
     find_elev = 0;
 
-    ObjectListNode* objectListNode;
-    for (find_tile = 0; find_tile < HEX_GRID_SIZE; find_tile++) {
+    // CE: Skip tiles without objects.
+    ObjectListNode* objectListNode = NULL;
+    for (find_tile = obj_index_next(0, -1, OBJ_INDEX_ANY); find_tile < HEX_GRID_SIZE; find_tile = obj_index_next(find_tile + 1, -1, OBJ_INDEX_ANY)) {
         objectListNode = objectTable[find_tile];
         if (objectListNode) {
             break;
         }
+
+        obj_index_clear(find_tile, -1, OBJ_INDEX_ANY);
     }
 
     if (find_tile == HEX_GRID_SIZE) {
@@ -2127,7 +2369,16 @@ Object* obj_find_next()
 
     while (find_tile < HEX_GRID_SIZE) {
         if (objectListNode == NULL) {
+            // CE: Skip tiles without objects.
+            find_tile = obj_index_next(find_tile, -1, OBJ_INDEX_ANY);
+            if (find_tile == HEX_GRID_SIZE) {
+                break;
+            }
+
             objectListNode = objectTable[find_tile++];
+            if (objectListNode == NULL) {
+                obj_index_clear(find_tile - 1, -1, OBJ_INDEX_ANY);
+            }
         }
 
         while (objectListNode != NULL) {
@@ -2150,11 +2401,15 @@ Object* obj_find_first_at(int elevation)
     find_elev = elevation;
     find_tile = 0;
 
-    for (find_tile = 0; find_tile < HEX_GRID_SIZE; find_tile++) {
+    // CE: Skip tiles without objects at given elevation.
+    for (find_tile = obj_index_next(0, elevation, OBJ_INDEX_ANY); find_tile < HEX_GRID_SIZE; find_tile = obj_index_next(find_tile + 1, elevation, OBJ_INDEX_ANY)) {
+        bool candidate = false;
+
         ObjectListNode* objectListNode = objectTable[find_tile];
         while (objectListNode != NULL) {
             Object* object = objectListNode->obj;
             if (object->elevation == elevation) {
+                candidate = true;
                 if (!art_get_disable(FID_TYPE(object->fid))) {
                     find_ptr = objectListNode;
                     return object;
@@ -2162,6 +2417,10 @@ Object* obj_find_first_at(int elevation)
             }
             objectListNode = objectListNode->next;
         }
+
+        if (!candidate) {
+            obj_index_clear(find_tile, elevation, OBJ_INDEX_ANY);
+        }
     }
 
     find_ptr = NULL;
@@ -2178,13 +2437,26 @@ Object* obj_find_next_at()
     ObjectListNode* objectListNode = find_ptr->next;
 
     while (find_tile < HEX_GRID_SIZE) {
+        // CE: Whether walk started from the head of the tile list and whether
+        // it has seen any object at given elevation.
+        bool fresh = false;
+        bool candidate = false;
+
         if (objectListNode == NULL) {
+            // CE: Skip tiles without objects at given elevation.
+            find_tile = obj_index_next(find_tile, find_elev, OBJ_INDEX_ANY);
+            if (find_tile == HEX_GRID_SIZE) {
+                break;
+            }
+
             objectListNode = objectTable[find_tile++];
+            fresh = true;
         }
 
         while (objectListNode != NULL) {
             Object* object = objectListNode->obj;
             if (object->elevation == find_elev) {
+                candidate = true;
                 if (!art_get_disable(FID_TYPE(object->fid))) {
                     find_ptr = objectListNode;
                     return object;
@@ -2192,6 +2464,10 @@ Object* obj_find_next_at()
             }
             objectListNode = objectListNode->next;
         }
+
+        if (fresh && !candidate) {
+            obj_index_clear(find_tile - 1, find_elev, OBJ_INDEX_ANY);
+        }
     }
 
     find_ptr = NULL;
@@ -2295,15 +2571,30 @@ Object* obj_blocking_at(Object* a1, int tile, int elev)
         return NULL;
     }
 
+    // CE: Most tiles are free, avoid walking lists of the tile and its
+    // neighbours.
+    if (!elevationIsValid(elev)) {
+        return NULL;
+    }
+
+    if ((obj_blocking_bits[elev][tile >> 3] & (1 << (tile & 7))) == 0) {
+        return NULL;
+    }
+
+    // CE: Whether any object contributing to the bit was seen (see
+    // `obj_blocking_bits`).
+    bool candidate = false;
+
     objectListNode = objectTable[tile];
     while (objectListNode != NULL) {
         v7 = objectListNode->obj;
         if (v7->elevation == elev) {
-            if ((v7->flags & OBJECT_HIDDEN) == 0 && (v7->flags & OBJECT_NO_BLOCK) == 0 && v7 != a1) {
-                type = FID_TYPE(v7->fid);
-                if (type == OBJ_TYPE_CRITTER
-                    || type == OBJ_TYPE_SCENERY
-                    || type == OBJ_TYPE_WALL) {
+            type = FID_TYPE(v7->fid);
+            if (type == OBJ_TYPE_CRITTER
+                || type == OBJ_TYPE_SCENERY
+                || type == OBJ_TYPE_WALL) {
+                candidate = true;
+                if ((v7->flags & OBJECT_HIDDEN) == 0 && (v7->flags & OBJECT_NO_BLOCK) == 0 && v7 != a1) {
                     return v7;
                 }
             }
@@ -2319,11 +2610,12 @@ Object* obj_blocking_at(Object* a1, int tile, int elev)
                 v7 = objectListNode->obj;
                 if ((v7->flags & OBJECT_MULTIHEX) != 0) {
                     if (v7->elevation == elev) {
-                        if ((v7->flags & OBJECT_HIDDEN) == 0 && (v7->flags & OBJECT_NO_BLOCK) == 0 && v7 != a1) {
-                            type = FID_TYPE(v7->fid);
-                            if (type == OBJ_TYPE_CRITTER
-                                || type == OBJ_TYPE_SCENERY
-                                || type == OBJ_TYPE_WALL) {
+                        type = FID_TYPE(v7->fid);
+                        if (type == OBJ_TYPE_CRITTER
+                            || type == OBJ_TYPE_SCENERY
+                            || type == OBJ_TYPE_WALL) {
+                            candidate = true;
+                            if ((v7->flags & OBJECT_HIDDEN) == 0 && (v7->flags & OBJECT_NO_BLOCK) == 0 && v7 != a1) {
                                 return v7;
                             }
                         }
@@ -2334,9 +2626,92 @@ Object* obj_blocking_at(Object* a1, int tile, int elev)
         }
     }
 
+    if (!candidate) {
+        obj_blocking_bits[elev][tile >> 3] &= ~(1 << (tile & 7));
+        hpath_invalidate(tile, elev);
+    }
+
     return NULL;
 }
 
+// CE: Returns `true` if the tile is blocked by scenery or wall which cannot
+// be opened, that is ignoring critters and doors. Used by the path planner
+// which only deals with map layout (see `hpath_make_path`).
+bool obj_static_blocking_at(int tile, int elev)
+{
+    if (!hexGridTileIsValid(tile) || !elevationIsValid(elev)) {
+        return false;
+    }
+
+    if ((obj_blocking_bits[elev][tile >> 3] & (1 << (tile & 7))) == 0) {
+        return false;
+    }
+
+    for (int rotation = -1; rotation < ROTATION_COUNT; rotation++) {
+        int candidate = tile;
+        if (rotation != -1) {
+            candidate = tile_num_in_direction(tile, rotation, 1);
+            if (candidate == tile || !hexGridTileIsValid(candidate)) {
+                continue;
+            }
+        }
+
+        ObjectListNode* objectListNode = objectTable[candidate];
+        while (objectListNode != NULL) {
+            Object* obj = objectListNode->obj;
+            if (obj->elevation == elev
+                && (rotation == -1 || (obj->flags & OBJECT_MULTIHEX) != 0)
+                && (obj->flags & OBJECT_HIDDEN) == 0
+                && (obj->flags & OBJECT_NO_BLOCK) == 0) {
+                int type = FID_TYPE(obj->fid);
+                if (type == OBJ_TYPE_WALL) {
+                    return true;
+                }
+
+                if (type == OBJ_TYPE_SCENERY && !obj_is_a_portal(obj)) {
+                    return true;
+                }
+            }
+            objectListNode = objectListNode->next;
+        }
+    }
+
+    return false;
+}
+
+// CE: Returns number which changes whenever any tile might become blocked or
+// free, used to validate cached paths.
+unsigned int obj_blocking_version()
+{
+    return obj_blocking_serial;
+}
+
+// CE: Returns number which changes whenever walls or scenery appear or
+// disappear, that is when `obj_static_blocking_at` might have changed.
+//
+// NOTE: Flag changes are not tracked, users must tolerate stale results
+// (see `flow_make_path`).
+unsigned int obj_blocking_static_version()
+{
+    return obj_blocking_static_serial;
+}
+
+// CE: Should be called when `OBJECT_HIDDEN` or `OBJECT_NO_BLOCK` flag of
+// critter, scenery or wall is changed, or door is locked or unlocked. Moving
+// objects is tracked automatically.
+void obj_blocking_changed()
+{
+    obj_blocking_serial++;
+}
+
+// CE: Returns `true` if the tile is blocked by any object. Same as
+// `obj_blocking_at` with `NULL` object, but meant for callers which do not
+// need to know which object blocks the tile.
+bool tile_is_blocked(int tile, int elevation)
+{
+    return obj_blocking_at(NULL, tile, elevation) != NULL;
+}
+
 // 0x47D3D8
 int obj_scroll_blocking_at(int tile, int elev)
 {
@@ -2364,21 +2739,37 @@ int obj_scroll_blocking_at(int tile, int elev)
 // 0x47D41C
 Object* obj_sight_blocking_at(Object* a1, int tile, int elevation)
 {
+    // CE: Most tiles have no scenery or walls.
+    if (elevationIsValid(elevation)
+        && (obj_sight_bits[elevation][tile >> 3] & (1 << (tile & 7))) == 0) {
+        return NULL;
+    }
+
+    // CE: Whether any object contributing to the bit was seen (see
+    // `obj_sight_bits`).
+    bool candidate = false;
+
     ObjectListNode* objectListNode = objectTable[tile];
     while (objectListNode != NULL) {
         Object* object = objectListNode->obj;
-        if (object->elevation == elevation
-            && (object->flags & OBJECT_HIDDEN) == 0
-            && (object->flags & OBJECT_LIGHT_THRU) == 0
-            && object != a1) {
+        if (object->elevation == elevation) {
             int objectType = FID_TYPE(object->fid);
             if (objectType == OBJ_TYPE_SCENERY || objectType == OBJ_TYPE_WALL) {
-                return object;
+                candidate = true;
+                if ((object->flags & OBJECT_HIDDEN) == 0
+                    && (object->flags & OBJECT_LIGHT_THRU) == 0
+                    && object != a1) {
+                    return object;
+                }
             }
         }
         objectListNode = objectListNode->next;
     }
 
+    if (!candidate && elevationIsValid(elevation)) {
+        obj_sight_bits[elevation][tile >> 3] &= ~(1 << (tile & 7));
+    }
+
     return NULL;
 }
 
@@ -2409,19 +2800,31 @@ int obj_create_list(int tile, int elevation, int objectType, Object*** objectLis
         return -1;
     }
 
+    // CE: Only tiles which might have objects of given type at given
+    // elevation are walked.
+    int slot = obj_index_slot(objectType);
+
     int count = 0;
     if (tile == -1) {
-        for (int index = 0; index < HEX_GRID_SIZE; index++) {
+        for (int index = obj_index_next(0, elevation, slot); index < HEX_GRID_SIZE; index = obj_index_next(index + 1, elevation, slot)) {
+            bool candidate = false;
+
             ObjectListNode* objectListNode = objectTable[index];
             while (objectListNode != NULL) {
                 Object* obj = objectListNode->obj;
-                if ((obj->flags & OBJECT_HIDDEN) == 0
-                    && obj->elevation == elevation
+                if (obj->elevation == elevation
                     && FID_TYPE(obj->fid) == objectType) {
-                    count++;
+                    candidate = true;
+                    if ((obj->flags & OBJECT_HIDDEN) == 0) {
+                        count++;
+                    }
                 }
                 objectListNode = objectListNode->next;
             }
+
+            if (!candidate && slot != OBJ_INDEX_ANY) {
+                obj_index_clear(index, elevation, slot);
+            }
         }
     } else {
         ObjectListNode* objectListNode = objectTable[tile];
@@ -2446,7 +2849,7 @@ int obj_create_list(int tile, int elevation, int objectType, Object*** objectLis
     }
 
     if (tile == -1) {
-        for (int index = 0; index < HEX_GRID_SIZE; index++) {
+        for (int index = obj_index_next(0, elevation, slot); index < HEX_GRID_SIZE; index = obj_index_next(index + 1, elevation, slot)) {
             ObjectListNode* objectListNode = objectTable[index];
             while (objectListNode) {
                 Object* obj = objectListNode->obj;
@@ -2976,6 +3379,12 @@ static int obj_object_table_init()
         objectTable[tile] = NULL;
     }
 
+    // CE: Reset blocking bitmap and path planner built from it.
+    memset(obj_blocking_bits, 0, sizeof(obj_blocking_bits));
+    memset(obj_sight_bits, 0, sizeof(obj_sight_bits));
+    memset(obj_index_bits, 0, sizeof(obj_index_bits));
+    hpath_reset();
+
     return 0;
 }
 
@@ -3463,7 +3872,8 @@ static int obj_create_object(Object** objectPtr)
         return -1;
     }
 
-    Object* object = *objectPtr = (Object*)mem_malloc(sizeof(Object));
+    // CE: Allocate from pool.
+    Object* object = *objectPtr = (Object*)obj_pool_alloc(&obj_object_pool);
     if (object == NULL) {
         return -1;
     }
@@ -3493,7 +3903,7 @@ static void obj_destroy_object(Object** objectPtr)
         return;
     }
 
-    mem_free(*objectPtr);
+    obj_pool_free(&obj_object_pool, *objectPtr);
 
     *objectPtr = NULL;
 }
@@ -3505,7 +3915,8 @@ static int obj_create_object_node(ObjectListNode** nodePtr)
         return -1;
     }
 
-    ObjectListNode* node = *nodePtr = (ObjectListNode*)mem_malloc(sizeof(*node));
+    // CE: Allocate from pool.
+    ObjectListNode* node = *nodePtr = (ObjectListNode*)obj_pool_alloc(&obj_node_pool);
     if (node == NULL) {
         return -1;
     }
@@ -3527,11 +3938,77 @@ static void obj_destroy_object_node(ObjectListNode** nodePtr)
         return;
     }
 
-    mem_free(*nodePtr);
+    obj_pool_free(&obj_node_pool, *nodePtr);
 
     *nodePtr = NULL;
 }
 
+// CE: Returns uninitialized block from pool, allocating new chunk if there
+// are no free blocks.
+static void* obj_pool_alloc(ObjectPool* pool)
+{
+    if (pool->freeList == NULL) {
+        // First block of the chunk holds link to the next chunk.
+        unsigned char* chunk = (unsigned char*)mem_malloc(pool->blockSize * (pool->chunkLength + 1));
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        *(void**)chunk = pool->chunks;
+        pool->chunks = chunk;
+        pool->chunkCount++;
+
+        // Link blocks in address order so consecutive allocations are
+        // adjacent in memory.
+        for (int index = pool->chunkLength; index >= 1; index--) {
+            void* block = chunk + pool->blockSize * index;
+            *(void**)block = pool->freeList;
+            pool->freeList = block;
+        }
+    }
+
+    void* block = pool->freeList;
+    pool->freeList = *(void**)block;
+
+    pool->used++;
+    if (pool->used > pool->peak) {
+        pool->peak = pool->used;
+    }
+
+    return block;
+}
+
+static void obj_pool_free(ObjectPool* pool, void* block)
+{
+    *(void**)block = pool->freeList;
+    pool->freeList = block;
+    pool->used--;
+}
+
+// CE: Releases chunks of the pool unless some blocks are still in use
+// (objects which were never removed).
+static void obj_pool_exit(ObjectPool* pool)
+{
+    debug_printf("obj: %s pool %d chunks, peak %d, %d in use\n",
+        pool->name,
+        pool->chunkCount,
+        pool->peak,
+        pool->used);
+
+    if (pool->used != 0) {
+        return;
+    }
+
+    while (pool->chunks != NULL) {
+        void* next = *(void**)pool->chunks;
+        mem_free(pool->chunks);
+        pool->chunks = next;
+    }
+
+    pool->chunkCount = 0;
+    pool->freeList = NULL;
+}
+
 // 0x47EF50
 static int obj_node_ptr(Object* object, ObjectListNode** nodePtr, ObjectListNode** previousNodePtr)
 {
@@ -3637,6 +4114,212 @@ static void obj_insert(ObjectListNode* objectListNode)
 
     objectListNode->next = *objectListNodePtr;
     *objectListNodePtr = objectListNode;
+
+    obj_blocking_mark(objectListNode->obj);
+    obj_index_mark(objectListNode->obj);
+}
+
+// CE: Returns `true` if object contributes to `obj_blocking_bits`.
+static bool obj_blocking_candidate(Object* obj)
+{
+    int type = FID_TYPE(obj->fid);
+    return type == OBJ_TYPE_CRITTER
+        || type == OBJ_TYPE_SCENERY
+        || type == OBJ_TYPE_WALL;
+}
+
+// CE: Sets blocking bits of tiles occupied by object.
+static void obj_blocking_mark(Object* obj)
+{
+    if (obj->tile == -1 || !elevationIsValid(obj->elevation)) {
+        return;
+    }
+
+    if (!obj_blocking_candidate(obj)) {
+        return;
+    }
+
+    // Path planner ignores critters.
+    if (FID_TYPE(obj->fid) != OBJ_TYPE_CRITTER) {
+        hpath_invalidate(obj->tile, obj->elevation);
+        obj_blocking_static_serial++;
+    }
+
+    obj_blocking_serial++;
+
+    unsigned char* bits = obj_blocking_bits[obj->elevation];
+    bits[obj->tile >> 3] |= 1 << (obj->tile & 7);
+
+    if (FID_TYPE(obj->fid) != OBJ_TYPE_CRITTER) {
+        obj_sight_bits[obj->elevation][obj->tile >> 3] |= 1 << (obj->tile & 7);
+    }
+
+    if ((obj->flags & OBJECT_MULTIHEX) != 0) {
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+            int neighboor = tile_num_in_direction(obj->tile, rotation, 1);
+            if (hexGridTileIsValid(neighboor)) {
+                bits[neighboor >> 3] |= 1 << (neighboor & 7);
+            }
+        }
+    }
+}
+
+// CE: Recomputes blocking bits of tiles occupied by object which has just
+// been unlinked from `objectTable` (its `tile` is not yet updated).
+static void obj_blocking_unmark(Object* obj)
+{
+    if (obj->tile == -1 || !elevationIsValid(obj->elevation)) {
+        return;
+    }
+
+    if (!obj_blocking_candidate(obj)) {
+        return;
+    }
+
+    if (FID_TYPE(obj->fid) != OBJ_TYPE_CRITTER) {
+        hpath_invalidate(obj->tile, obj->elevation);
+        obj_blocking_static_serial++;
+    }
+
+    obj_blocking_serial++;
+
+    obj_blocking_refresh(obj->tile, obj->elevation);
+
+    if ((obj->flags & OBJECT_MULTIHEX) != 0) {
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+            int neighboor = tile_num_in_direction(obj->tile, rotation, 1);
+            if (hexGridTileIsValid(neighboor)) {
+                obj_blocking_refresh(neighboor, obj->elevation);
+            }
+        }
+    }
+}
+
+// CE: Recomputes blocking and sight bits of the tile from `objectTable`.
+static void obj_blocking_refresh(int tile, int elevation)
+{
+    bool candidate = false;
+    bool sight = false;
+
+    ObjectListNode* objectListNode = objectTable[tile];
+    while (objectListNode != NULL) {
+        Object* obj = objectListNode->obj;
+        if (obj->elevation == elevation && obj_blocking_candidate(obj)) {
+            candidate = true;
+            if (FID_TYPE(obj->fid) != OBJ_TYPE_CRITTER) {
+                sight = true;
+                break;
+            }
+        }
+        objectListNode = objectListNode->next;
+    }
+
+    if (sight) {
+        obj_sight_bits[elevation][tile >> 3] |= 1 << (tile & 7);
+    } else {
+        obj_sight_bits[elevation][tile >> 3] &= ~(1 << (tile & 7));
+    }
+
+    for (int rotation = 0; rotation < ROTATION_COUNT && !candidate; rotation++) {
+        int neighboor = tile_num_in_direction(tile, rotation, 1);
+        if (hexGridTileIsValid(neighboor)) {
+            objectListNode = objectTable[neighboor];
+            while (objectListNode != NULL) {
+                Object* obj = objectListNode->obj;
+                if ((obj->flags & OBJECT_MULTIHEX) != 0
+                    && obj->elevation == elevation
+                    && obj_blocking_candidate(obj)) {
+                    candidate = true;
+                    break;
+                }
+                objectListNode = objectListNode->next;
+            }
+        }
+    }
+
+    if (candidate) {
+        obj_blocking_bits[elevation][tile >> 3] |= 1 << (tile & 7);
+    } else {
+        obj_blocking_bits[elevation][tile >> 3] &= ~(1 << (tile & 7));
+    }
+}
+
+// CE: Sets index bits of object's tile.
+static void obj_index_mark(Object* obj)
+{
+    if (obj->tile == -1 || !elevationIsValid(obj->elevation)) {
+        return;
+    }
+
+    unsigned int mask = 1u << (obj->tile & 31);
+    obj_index_bits[obj->elevation][OBJ_INDEX_ANY][obj->tile >> 5] |= mask;
+
+    int slot = obj_index_slot(FID_TYPE(obj->fid));
+    if (slot != OBJ_INDEX_ANY) {
+        obj_index_bits[obj->elevation][slot][obj->tile >> 5] |= mask;
+    }
+}
+
+// CE: Returns first tile starting from `tile` which might have objects of
+// given slot at given elevation (or at any elevation if `elevation` is -1),
+// or `HEX_GRID_SIZE` if there are no such tiles.
+static int obj_index_next(int tile, int elevation, int slot)
+{
+    if (elevation != -1 && !elevationIsValid(elevation)) {
+        return HEX_GRID_SIZE;
+    }
+
+    int word = tile >> 5;
+    unsigned int bits = 0;
+    if (word < (HEX_GRID_SIZE + 31) / 32) {
+        for (int index = 0; index < ELEVATION_COUNT; index++) {
+            if (elevation == -1 || elevation == index) {
+                bits |= obj_index_bits[index][slot][word];
+            }
+        }
+        bits &= ~0u << (tile & 31);
+    }
+
+    while (bits == 0) {
+        word++;
+        if (word >= (HEX_GRID_SIZE + 31) / 32) {
+            return HEX_GRID_SIZE;
+        }
+
+        for (int index = 0; index < ELEVATION_COUNT; index++) {
+            if (elevation == -1 || elevation == index) {
+                bits |= obj_index_bits[index][slot][word];
+            }
+        }
+    }
+
+    tile = word << 5;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        tile++;
+    }
+
+    return tile;
+}
+
+// CE: Clears stale index bit of the tile (at every elevation if `elevation`
+// is -1).
+static void obj_index_clear(int tile, int elevation, int slot)
+{
+    for (int index = 0; index < ELEVATION_COUNT; index++) {
+        if (elevation == -1 || elevation == index) {
+            obj_index_bits[index][slot][tile >> 5] &= ~(1u << (tile & 31));
+        }
+    }
+}
+
+static int obj_index_slot(int objectType)
+{
+    if (objectType >= 0 && objectType < OBJ_INDEX_ANY) {
+        return objectType;
+    }
+
+    return OBJ_INDEX_ANY;
 }
 
 // 0x47F13C
@@ -3668,6 +4351,9 @@ static int obj_remove(ObjectListNode* a1, ObjectListNode* a2)
                 objectTable[tile] = objectTable[tile]->next;
             }
         }
+
+        // CE: Let path planner know scenery and walls are gone.
+        obj_blocking_unmark(a1->obj);
     }
 
     // NOTE: Uninline.
@@ -4444,9 +5130,6 @@ static void obj_render_outline(Object* object, Rect* rect)
 
         unsigned char* src = art_frame_data(art, object->frame, object->rotation);
 
-        unsigned char* dest = back_buf + buf_full * object->sy + object->sx;
-        int destStep = buf_full - frameWidth;
-
         unsigned char color;
         unsigned char* v47 = NULL;
         unsigned char* v48 = NULL;
@@ -4499,126 +5182,200 @@ static void obj_render_outline(Object* object, Rect* rect)
             break;
         }
 
-        unsigned char v54 = color;
-        unsigned char* dest14 = dest;
-        unsigned char* src15 = src;
-        for (int y = 0; y < frameHeight; y++) {
-            bool cycle = true;
-            if (v44 != 0) {
-                if (y % v44 == 0) {
-                    v54++;
-                }
+        // CE: Edge positions depend on frame pixels only, they are computed
+        // once and cached (see `outline_mask_get`).
+        OutlineMask* mask = outline_mask_get(object->fid, object->frame, object->rotation, src, frameWidth, frameHeight);
+        if (mask == NULL) {
+            art_ptr_unlock(cacheEntry);
+            return;
+        }
 
-                if (v54 > v43 + color - 1) {
-                    v54 = color;
-                }
+        for (int index = 0; index < mask->count; index++) {
+            OutlineMaskOp* op = &(mask->ops[index]);
+            if (op->x < v49.ulx || op->x > v49.lrx || op->y < v49.uly || op->y > v49.lry) {
+                continue;
             }
 
-            int v22 = dest14 - back_buf;
-            for (int x = 0; x < frameWidth; x++) {
-                v22 = dest14 - back_buf;
-                if (*src15 != 0 && cycle) {
-                    if (x >= v49.ulx && x <= v49.lrx && y >= v49.uly && y <= v49.lry && v22 > 0 && v22 % buf_full != 0) {
-                        unsigned char v20;
-                        if (v53 != 0) {
-                            v20 = v48[(v47[v54] << 8) + *(dest14 - 1)];
-                        } else {
-                            v20 = v54;
-                        }
-                        *(dest14 - 1) = v20;
-                    }
-                    cycle = false;
-                } else if (*src15 == 0 && !cycle) {
-                    if (x >= v49.ulx && x <= v49.lrx && y >= v49.uly && y <= v49.lry) {
-                        int v21;
-                        if (v53 != 0) {
-                            v21 = v48[(v47[v54] << 8) + *dest14];
-                        } else {
-                            v21 = v54;
-                        }
-                        *dest14 = v21 & 0xFF;
-                    }
-                    cycle = true;
+            int offset = buf_full * (object->sy + op->y) + object->sx + op->x;
+            switch (op->type) {
+            case OUTLINE_MASK_OP_LEFT:
+                if (offset <= 0 || offset % buf_full == 0) {
+                    continue;
+                }
+                offset -= 1;
+                break;
+            case OUTLINE_MASK_OP_RIGHT:
+                if (offset >= buf_size) {
+                    continue;
+                }
+                offset += 1;
+                break;
+            case OUTLINE_MASK_OP_TOP:
+                offset -= buf_full;
+                if (offset < 0) {
+                    continue;
+                }
+                break;
+            case OUTLINE_MASK_OP_BOTTOM:
+                offset += buf_full;
+                if (offset >= buf_size) {
+                    continue;
                 }
-                dest14++;
-                src15++;
+                break;
             }
 
-            if (*(src15 - 1) != 0) {
-                if (v22 < buf_size) {
-                    int v23 = frameWidth - 1;
-                    if (v23 >= v49.ulx && v23 <= v49.lrx && y >= v49.uly && y <= v49.lry) {
-                        if (v53 != 0) {
-                            *dest14 = v48[(v47[v54] << 8) + *dest14];
-                        } else {
-                            *dest14 = v54;
-                        }
-                    }
-                }
+            unsigned char v54 = color;
+            if (v44 != 0) {
+                v54 = color + (op->y / v44 + 1) % v43;
             }
 
-            dest14 += destStep;
+            if (v53 != 0) {
+                back_buf[offset] = v48[(v47[v54] << 8) + back_buf[offset]];
+            } else {
+                back_buf[offset] = v54;
+            }
         }
+    }
 
-        for (int x = 0; x < frameWidth; x++) {
-            bool cycle = true;
-            unsigned char v28 = color;
-            unsigned char* dest27 = dest + x;
-            unsigned char* src27 = src + x;
-            for (int y = 0; y < frameHeight; y++) {
-                if (v44 != 0) {
-                    if (y % v44 == 0) {
-                        v28++;
-                    }
+    art_ptr_unlock(cacheEntry);
+}
 
-                    if (v28 > color + v43 - 1) {
-                        v28 = color;
-                    }
-                }
+// CE: Returns outline mask for the given frame, building it if needed.
+static OutlineMask* outline_mask_get(int fid, int frame, int rotation, unsigned char* src, int width, int height)
+{
+    OutlineMask* victim = &(outline_masks[0]);
+    for (int index = 0; index < OUTLINE_MASK_CACHE_SIZE; index++) {
+        OutlineMask* mask = &(outline_masks[index]);
+        if (mask->ops != NULL
+            && mask->fid == fid
+            && mask->frame == frame
+            && mask->rotation == rotation
+            && mask->width == width
+            && mask->height == height) {
+            mask->mru = ++outline_mask_mru;
+            return mask;
+        }
 
-                if (*src27 != 0 && cycle) {
-                    if (x >= v49.ulx && x <= v49.lrx && y >= v49.uly && y <= v49.lry) {
-                        unsigned char* v29 = dest27 - buf_full;
-                        if (v29 >= back_buf) {
-                            if (v53) {
-                                *v29 = v48[(v47[v28] << 8) + *v29];
-                            } else {
-                                *v29 = v28;
-                            }
-                        }
-                    }
-                    cycle = false;
-                } else if (*src27 == 0 && !cycle) {
-                    if (x >= v49.ulx && x <= v49.lrx && y >= v49.uly && y <= v49.lry) {
-                        if (v53) {
-                            *dest27 = v48[(v47[v28] << 8) + *dest27];
-                        } else {
-                            *dest27 = v28;
-                        }
-                    }
-                    cycle = true;
+        if (victim->ops != NULL && (mask->ops == NULL || mask->mru < victim->mru)) {
+            victim = mask;
+        }
+    }
+
+    if (width <= 0 || height <= 0) {
+        return NULL;
+    }
+
+    int count = outline_mask_build(src, width, height, NULL);
+
+    // Fully transparent frames still get (empty) mask to avoid rescanning.
+    OutlineMaskOp* ops = (OutlineMaskOp*)mem_malloc(sizeof(*ops) * (count != 0 ? count : 1));
+    if (ops == NULL) {
+        return NULL;
+    }
+
+    outline_mask_build(src, width, height, ops);
+
+    if (victim->ops != NULL) {
+        mem_free(victim->ops);
+    }
+
+    victim->fid = fid;
+    victim->frame = frame;
+    victim->rotation = rotation;
+    victim->width = width;
+    victim->height = height;
+    victim->mru = ++outline_mask_mru;
+    victim->count = count;
+    victim->ops = ops;
+
+    return victim;
+}
+
+// CE: Scans frame for outline edges and stores them in `ops` (if not NULL).
+// Returns number of edges.
+static int outline_mask_build(unsigned char* src, int width, int height, OutlineMaskOp* ops)
+{
+    int count = 0;
+
+    for (int y = 0; y < height; y++) {
+        unsigned char* row = src + width * y;
+        bool cycle = true;
+        for (int x = 0; x < width; x++) {
+            if (row[x] != 0 && cycle) {
+                if (ops != NULL) {
+                    ops[count].x = x;
+                    ops[count].y = y;
+                    ops[count].type = OUTLINE_MASK_OP_LEFT;
+                }
+                count++;
+                cycle = false;
+            } else if (row[x] == 0 && !cycle) {
+                if (ops != NULL) {
+                    ops[count].x = x;
+                    ops[count].y = y;
+                    ops[count].type = OUTLINE_MASK_OP_EDGE;
                 }
+                count++;
+                cycle = true;
+            }
+        }
 
-                dest27 += buf_full;
-                src27 += frameWidth;
+        if (row[width - 1] != 0) {
+            if (ops != NULL) {
+                ops[count].x = width - 1;
+                ops[count].y = y;
+                ops[count].type = OUTLINE_MASK_OP_RIGHT;
             }
+            count++;
+        }
+    }
 
-            if (src27[-frameWidth] != 0) {
-                if (dest27 - back_buf < buf_size) {
-                    int y = frameHeight - 1;
-                    if (x >= v49.ulx && x <= v49.lrx && y >= v49.uly && y <= v49.lry) {
-                        if (v53) {
-                            *dest27 = v48[(v47[v28] << 8) + *dest27];
-                        } else {
-                            *dest27 = v28;
-                        }
-                    }
+    for (int x = 0; x < width; x++) {
+        bool cycle = true;
+        for (int y = 0; y < height; y++) {
+            unsigned char pixel = src[width * y + x];
+            if (pixel != 0 && cycle) {
+                if (ops != NULL) {
+                    ops[count].x = x;
+                    ops[count].y = y;
+                    ops[count].type = OUTLINE_MASK_OP_TOP;
                 }
+                count++;
+                cycle = false;
+            } else if (pixel == 0 && !cycle) {
+                if (ops != NULL) {
+                    ops[count].x = x;
+                    ops[count].y = y;
+                    ops[count].type = OUTLINE_MASK_OP_EDGE;
+                }
+                count++;
+                cycle = true;
             }
         }
+
+        if (src[width * (height - 1) + x] != 0) {
+            if (ops != NULL) {
+                ops[count].x = x;
+                ops[count].y = height - 1;
+                ops[count].type = OUTLINE_MASK_OP_BOTTOM;
+            }
+            count++;
+        }
     }
 
-    art_ptr_unlock(cacheEntry);
+    return count;
+}
+
+// CE: Releases all cached outline masks.
+static void outline_mask_cache_free()
+{
+    for (int index = 0; index < OUTLINE_MASK_CACHE_SIZE; index++) {
+        OutlineMask* mask = &(outline_masks[index]);
+        if (mask->ops != NULL) {
+            mem_free(mask->ops);
+            mask->ops = NULL;
+        }
+    }
 }
 
 // 0x480868
@@ -49,6 +49,7 @@ int obj_set_rotation(Object* obj, int direction, Rect* rect);
 int obj_inc_rotation(Object* obj, Rect* rect);
 int obj_dec_rotation(Object* obj, Rect* rect);
 void obj_rebuild_all_light();
+int obj_rebuild_light(Rect* rect);
 int obj_set_light(Object* obj, int lightDistance, int lightIntensity, Rect* rect);
 int obj_get_visible_light(Object* obj);
 int obj_turn_on_light(Object* obj, Rect* rect);
@@ -70,6 +71,11 @@ Object* obj_find_next_at();
 void obj_bound(Object* obj, Rect* rect);
 bool obj_occupied(int tile_num, int elev);
 Object* obj_blocking_at(Object* a1, int tile_num, int elev);
+bool obj_static_blocking_at(int tile, int elev);
+bool tile_is_blocked(int tile, int elevation);
+unsigned int obj_blocking_version();
+unsigned int obj_blocking_static_version();
+void obj_blocking_changed();
 int obj_scroll_blocking_at(int tile_num, int elev);
 Object* obj_sight_blocking_at(Object* a1, int tile_num, int elev);
 int obj_dist(Object* object1, Object* object2);
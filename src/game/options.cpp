@@ -1662,6 +1662,9 @@ static int PrefEnd()
         SavePrefs(1);
         JustUpdate();
         combat_highlight_change();
+
+        // CE: Combat difficulty affects to-hit chances.
+        combat_to_hit_invalidate();
     }
 
     win_delete(prfwin);
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 
+#include "game/combat.h"
 #include "game/game.h"
 #include "game/gconfig.h"
 #include "game/message.h"
@@ -249,6 +250,9 @@ int perk_add(int perk)
 
     perk_add_effect(obj_dude, perk);
 
+    // CE: See `determine_to_hit_memo`.
+    combat_to_hit_invalidate();
+
     return 0;
 }
 
@@ -267,6 +271,9 @@ int perk_sub(int perk)
 
     perk_remove_effect(obj_dude, perk);
 
+    // CE: See `determine_to_hit_memo`.
+    combat_to_hit_invalidate();
+
     return 0;
 }
 
@@ -1091,8 +1091,11 @@ int obj_use_item_on(Object* a1, Object* a2, Object* a3)
 // 0x48B63C
 static int rebuild_all_light()
 {
-    obj_rebuild_all_light();
-    tile_refresh_display();
+    // CE: Redraw only area affected by light change.
+    Rect rect;
+    if (obj_rebuild_light(&rect) == 0) {
+        tile_refresh_rect(&rect, map_elevation);
+    }
     return 0;
 }
 
@@ -1205,6 +1208,7 @@ static int check_door_state(Object* a1, Object* a2)
 {
     if ((a1->data.scenery.door.openFlags & 0x01) == 0) {
         a1->flags &= ~OBJECT_OPEN_DOOR;
+        obj_blocking_changed();
 
         // NOTE: Uninline.
         rebuild_all_light();
@@ -1240,6 +1244,7 @@ static int check_door_state(Object* a1, Object* a2)
         return 0;
     } else {
         a1->flags |= OBJECT_OPEN_DOOR;
+        obj_blocking_changed();
 
         // NOTE: Uninline.
         rebuild_all_light();
@@ -1553,6 +1558,7 @@ int obj_lock(Object* object)
         break;
     case OBJ_TYPE_SCENERY:
         object->data.scenery.door.openFlags |= OBJ_LOCKED;
+        obj_blocking_changed();
         break;
     default:
         return -1;
@@ -1574,6 +1580,7 @@ int obj_unlock(Object* object)
         return 0;
     case OBJ_TYPE_SCENERY:
         object->data.scenery.door.openFlags &= ~OBJ_LOCKED;
+        obj_blocking_changed();
         return 0;
     }
 
@@ -1756,7 +1763,7 @@ int obj_attempt_placement(Object* obj, int tile, int elevation, int a4)
     }
 
     int newTile = tile;
-    if (obj_blocking_at(NULL, tile, elevation) != NULL) {
+    if (tile_is_blocked(tile, elevation)) {
         int v6 = a4;
         if (a4 < 1) {
             v6 = 1;
@@ -1765,7 +1772,7 @@ int obj_attempt_placement(Object* obj, int tile, int elevation, int a4)
         while (v6 < 7) {
             for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
                 newTile = tile_num_in_direction(tile, rotation, v6);
-                if (obj_blocking_at(NULL, newTile, elevation) == NULL && v6 > 1 && make_path(obj_dude, obj_dude->tile, newTile, NULL, 0) != 0) {
+                if (!tile_is_blocked(newTile, elevation) && v6 > 1 && make_path(obj_dude, obj_dude->tile, newTile, NULL, 0) != 0) {
                     break;
                 }
             }
@@ -1776,7 +1783,7 @@ int obj_attempt_placement(Object* obj, int tile, int elevation, int a4)
         if (a4 != 1 && v6 > a4 + 2) {
             for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
                 int candidate = tile_num_in_direction(tile, rotation, 1);
-                if (obj_blocking_at(NULL, candidate, elevation) == NULL) {
+                if (!tile_is_blocked(candidate, elevation)) {
                     newTile = candidate;
                     break;
                 }
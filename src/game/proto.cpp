@@ -793,6 +793,7 @@ int proto_dude_init(const char* path)
 
     if ((obj_dude->flags & OBJECT_NO_BLOCK) != 0) {
         obj_dude->flags &= ~OBJECT_NO_BLOCK;
+        obj_blocking_changed();
     }
 
     stat_recalc_derived(obj_dude);
@@ -30,6 +30,7 @@
 #include "plib/gnw/input.h"
 #include "plib/gnw/intrface.h"
 #include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
 #include "xboxkrnl/xboxkrnl.h"
 namespace fallout {
 
@@ -763,6 +764,8 @@ int scripts_clear_combat_requests(Script* script)
 // 0x492250
 int scripts_check_state()
 {
+    PROFILE_ZONE("scripts");
+
     WorldMapContext ctx;
 
     if (scriptState.requests == 0) {
@@ -834,6 +837,7 @@ int scripts_check_state()
                         obj_set_frame(elevatorDoors, 0, NULL);
                         obj_move_to_tile(elevatorDoors, elevatorDoors->tile, elevatorDoors->elevation, NULL);
                         elevatorDoors->flags &= ~OBJECT_OPEN_DOOR;
+                        obj_blocking_changed();
                         elevatorDoors->data.scenery.door.openFlags &= ~0x01;
                         obj_rebuild_all_light();
                     } else {
@@ -856,6 +860,7 @@ int scripts_check_state()
                     obj_set_frame(elevatorDoors, 0, NULL);
                     obj_move_to_tile(elevatorDoors, elevatorDoors->tile, elevatorDoors->elevation, NULL);
                     elevatorDoors->flags &= ~OBJECT_OPEN_DOOR;
+                    obj_blocking_changed();
                     elevatorDoors->data.scenery.door.openFlags &= ~0x01;
                     obj_rebuild_all_light();
                 } else {
@@ -939,6 +944,7 @@ int scripts_check_state_in_combat()
                         obj_set_frame(elevatorDoors, 0, NULL);
                         obj_move_to_tile(elevatorDoors, elevatorDoors->tile, elevatorDoors->elevation, NULL);
                         elevatorDoors->flags &= ~OBJECT_OPEN_DOOR;
+                        obj_blocking_changed();
                         elevatorDoors->data.scenery.door.openFlags &= ~0x01;
                         obj_rebuild_all_light();
                     } else {
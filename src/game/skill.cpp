@@ -189,6 +189,9 @@ void skill_set_tags(int* skills, int count)
     for (index = 0; index < count; index++) {
         tag_skill[index] = skills[index];
     }
+
+    // CE: See `determine_to_hit_memo`.
+    combat_to_hit_invalidate();
 }
 
 // 0x498364
@@ -295,6 +298,9 @@ int skill_inc_point(Object* obj, int skill)
     rc = stat_pc_set(PC_STAT_UNSPENT_SKILL_POINTS, unspent_skill_points - 1);
     if (rc == 0) {
         proto->critter.data.skills[skill] += 1;
+
+        // CE: See `determine_to_hit_memo`.
+        combat_to_hit_invalidate();
     }
 
     return rc;
@@ -326,6 +332,9 @@ int skill_dec_point(Object* critter, int skill)
     rc = stat_pc_set(PC_STAT_UNSPENT_SKILL_POINTS, unspent_skill_points + 1);
     if (rc == 0) {
         proto->critter.data.skills[skill] -= 1;
+
+        // CE: See `determine_to_hit_memo`.
+        combat_to_hit_invalidate();
     }
 
     return 0;
@@ -307,6 +307,9 @@ int stat_set_base(Object* critter, int stat, int value)
         proto_ptr(critter->pid, &proto);
         proto->critter.data.baseStats[stat] = value;
 
+        // CE: See `determine_to_hit_memo`.
+        combat_to_hit_invalidate();
+
         if (stat >= STAT_STRENGTH && stat <= STAT_LUCK) {
             stat_recalc_derived(critter);
         }
@@ -363,6 +366,9 @@ int stat_set_bonus(Object* critter, int stat, int value)
         proto_ptr(critter->pid, &proto);
         proto->critter.data.bonusStats[stat] = value;
 
+        // CE: See `determine_to_hit_memo`.
+        combat_to_hit_invalidate();
+
         if (stat >= STAT_STRENGTH && stat <= STAT_LUCK) {
             stat_recalc_derived(critter);
         }
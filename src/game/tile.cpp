@@ -4,6 +4,8 @@
 #include <limits.h>
 #include <string.h>
 
+#include <algorithm>
+
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -18,11 +20,32 @@
 #include "plib/gnw/debug.h"
 #include "plib/gnw/grbuf.h"
 #include "plib/gnw/input.h"
+#include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
 
 namespace fallout {
 
 #define TILE_IS_VALID(tile) ((tile) >= 0 && (tile) < grid_size)
 
+// Size of pre-rendered floor chunk (in pixels).
+#define FLOOR_CHUNK_WIDTH 256
+#define FLOOR_CHUNK_HEIGHT 128
+#define FLOOR_CHUNK_SIZE (FLOOR_CHUNK_WIDTH * FLOOR_CHUNK_HEIGHT)
+
+// Default floor cache budget (in kilobytes).
+#define FLOOR_CACHE_DEFAULT_SIZE 1024
+
+// The area (in pixels around tile's screen position) of floor which can be
+// affected by changing light intensity of that tile. Floor squares sample
+// light from up to three hex rows below and two hex columns around their
+// base tile, so this is a conservative bound.
+#define FLOOR_LIGHT_MARGIN_X 192
+#define FLOOR_LIGHT_MARGIN_Y 96
+
+// Size of roof tile art (in pixels).
+#define ROOF_TILE_WIDTH 80
+#define ROOF_TILE_HEIGHT 36
+
 typedef struct RightsideUpTableEntry {
     int field_0;
     int field_4;
@@ -51,12 +74,73 @@ typedef struct UpsideDownTriangle {
     int field_8;
 } UpsideDownTriangle;
 
+// Pre-rendered 8-bit floor chunk.
+//
+// Chunks are positioned in map space, which is screen space relative to the
+// top left corner of square 0. This way chunks survive scrolling.
+typedef struct FloorChunk {
+    // Elevation of this chunk, or -1 if chunk slot is unused.
+    int elevation;
+
+    // Chunk coordinates in map space (in chunk units).
+    int x;
+    int y;
+
+    // The most recent access in terms of floor cache clock. Used to evict
+    // least recently used chunks when cache budget is exhausted.
+    unsigned int mru;
+
+    unsigned char* data;
+} FloorChunk;
+
+// Connected (4-way) group of roof squares.
+typedef struct RoofRegion {
+    // Index of the first square of this region in `RoofRegionMap.squares`.
+    int start;
+    int count;
+
+    // Bounds in square grid coordinates.
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+} RoofRegion;
+
+// Roof regions of a single elevation.
+typedef struct RoofRegionMap {
+    bool valid;
+
+    // Region index + 1 for every square, 0 for squares without roof.
+    unsigned short* ids;
+
+    // Square indices grouped by region.
+    int* squares;
+
+    RoofRegion* regions;
+    int regionCount;
+} RoofRegionMap;
+
 static void refresh_mapper(Rect* rect, int elevation);
 static void refresh_game(Rect* rect, int elevation);
 static bool tile_on_edge(int tile);
 static void roof_fill_on(int x, int y, int elevation);
 static void roof_fill_off(int x, int y, int elevation);
+static bool roof_present(int squareTile, int elevation);
+static RoofRegion* roof_region_at(int x, int y, int elevation);
+static int roof_regions_build(int elevation);
+static void roof_regions_free();
+static void roof_flood_fill(int x, int y, int elevation, int mask, int match, bool set);
 static void roof_draw(int fid, int x, int y, Rect* rect, int light);
+static void map_origin(int* x, int* y);
+static void tile_blit(Rect* rect);
+static void tile_refresh_scrolled();
+static void display_state_update();
+static void square_render_floor_into(Rect* rect, int elevation, unsigned char* dest, int destPitch, Rect* destRect);
+static void floor_draw_into(int fid, int x, int y, Rect* rect, unsigned char* dest, int destPitch, Rect* destRect);
+static void floor_cache_free();
+static void floor_cache_flush(int elevation);
+static unsigned char* floor_cache_get(int elevation, int chunkX, int chunkY, int originX, int originY);
+static void floor_cache_render(Rect* rect, int elevation);
 
 // 0x508330
 static bool borderInitialized = false;
@@ -264,6 +348,53 @@ static int square_width;
 // 0x668E54
 int tile_center_tile;
 
+static Rect tile_bounds_rect;
+static int tile_bounds_left_off;
+static int tile_bounds_top_off;
+static int tile_bounds_right_off;
+static int tile_bounds_bottom_off;
+
+// Describes what display buffer currently shows. When view is moved the
+// buffer contents is shifted by the map origin delta, so that only newly
+// exposed areas are rendered.
+static bool display_valid = false;
+static int display_elevation;
+static int display_origin_x;
+static int display_origin_y;
+
+// Tile bounds (in map space) at the time display buffer was rendered.
+static Rect display_bounds;
+
+// Blits requested while blit batch is open are merged into single rect.
+static int blit_batch_depth;
+static bool blit_batch_dirty;
+static Rect blit_batch_rect;
+
+static unsigned int scroll_shift_count;
+static unsigned int scroll_shift_time;
+static unsigned int scroll_full_count;
+static unsigned int scroll_full_time;
+
+// Floor cache budget (in chunks), 0 means floor cache is disabled.
+static int floor_cache_capacity;
+
+// Floor cache slots, allocated on first use.
+static FloorChunk* floor_cache;
+
+// Incremented on every floor cache access.
+static unsigned int floor_cache_clock;
+
+static unsigned int floor_cache_hits;
+static unsigned int floor_cache_misses;
+
+// Accumulated area (in map space) of light changes which are not yet applied
+// to floor cache.
+static Rect floor_cache_dirty_rect[ELEVATION_COUNT];
+static bool floor_cache_dirty[ELEVATION_COUNT];
+
+// Roof regions, built on map load (or on first use).
+static RoofRegionMap roof_regions[ELEVATION_COUNT];
+
 // 0x49D880
 int tile_init(TileData** a1, int squareGridWidth, int squareGridHeight, int hexGridWidth, int hexGridHeight, unsigned char* buffer, int windowWidth, int windowHeight, int windowPitch, TileWindowRefreshProc* windowRefreshProc)
 {
@@ -423,6 +554,19 @@ int tile_init(TileData** a1, int squareGridWidth, int squareGridHeight, int hexG
         tile_refresh = refresh_mapper;
     }
 
+    // CE: Floor cache. Mapper edits squares directly, so keep it disabled
+    // there.
+    int floorCacheSize;
+    if (!config_get_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_FLOOR_CACHE_SIZE_KEY, &floorCacheSize)) {
+        floorCacheSize = FLOOR_CACHE_DEFAULT_SIZE;
+    }
+
+    if (compat_stricmp(executable, "mapper") == 0 || floorCacheSize < 0) {
+        floorCacheSize = 0;
+    }
+
+    floor_cache_capacity = (floorCacheSize << 10) / FLOOR_CHUNK_SIZE;
+
     return 0;
 }
 
@@ -455,17 +599,24 @@ void tile_set_border(int windowWidth, int windowHeight, int hexGridWidth, int he
 // 0x49DE80
 void tile_reset()
 {
+    tile_floor_cache_invalidate(-1);
 }
 
 // 0x49DE80
 void tile_exit()
 {
+    floor_cache_free();
+    roof_regions_free();
 }
 
 // 0x49DE8C
 void tile_disable_refresh()
 {
     refresh_enabled = false;
+
+    // CE: Whatever happens while refresh is disabled is not reflected in
+    // display buffer.
+    display_valid = false;
 }
 
 // 0x49DE98
@@ -474,11 +625,31 @@ void tile_enable_refresh()
     refresh_enabled = true;
 }
 
+// CE: Forces the next view change to refresh the whole window instead of
+// shifting display buffer contents.
+void tile_display_invalidate()
+{
+    display_valid = false;
+}
+
 // 0x49DEA4
 void tile_refresh_rect(Rect* rect, int elevation)
 {
+    PROFILE_ZONE("tile_refresh");
+
     if (refresh_enabled) {
         if (elevation == map_elevation) {
+            if (display_valid) {
+                // CE: View was moved without refreshing the window, display
+                // buffer is now a mix of old and new view.
+                int originX;
+                int originY;
+                map_origin(&originX, &originY);
+                if (originX != display_origin_x || originY != display_origin_y || elevation != display_elevation) {
+                    display_valid = false;
+                }
+            }
+
             tile_refresh(rect, elevation);
         }
     }
@@ -487,9 +658,169 @@ void tile_refresh_rect(Rect* rect, int elevation)
 // 0x49DEBC
 void tile_refresh_display()
 {
+    PROFILE_ZONE("tile_refresh");
+
     if (refresh_enabled) {
         tile_refresh(&buf_rect, map_elevation);
+        display_state_update();
+    }
+}
+
+// Starts accumulating refreshed areas. Window is updated once with the bounding
+// rect of all refreshed areas when the batch is closed.
+void tile_refresh_begin_batch()
+{
+    blit_batch_depth++;
+}
+
+void tile_refresh_end_batch()
+{
+    if (blit_batch_depth == 0) {
+        return;
+    }
+
+    blit_batch_depth--;
+
+    if (blit_batch_depth == 0 && blit_batch_dirty) {
+        blit_batch_dirty = false;
+        blit(&blit_batch_rect);
+    }
+}
+
+static void tile_blit(Rect* rect)
+{
+    if (blit_batch_depth != 0) {
+        if (blit_batch_dirty) {
+            rect_min_bound(&blit_batch_rect, rect, &blit_batch_rect);
+        } else {
+            blit_batch_rect = *rect;
+            blit_batch_dirty = true;
+        }
+        return;
+    }
+
+    blit(rect);
+}
+
+static void display_state_update()
+{
+    map_origin(&display_origin_x, &display_origin_y);
+    display_elevation = map_elevation;
+    display_bounds.ulx = tile_bounds_rect.ulx - display_origin_x;
+    display_bounds.uly = tile_bounds_rect.uly - display_origin_y;
+    display_bounds.lrx = tile_bounds_rect.lrx - display_origin_x;
+    display_bounds.lry = tile_bounds_rect.lry - display_origin_y;
+    display_valid = true;
+}
+
+// Refreshes window after view was moved. If display buffer holds valid
+// contents of the previous view, it's shifted by the view delta and only
+// newly exposed strips are rendered, otherwise falls back to full refresh.
+static void tile_refresh_scrolled()
+{
+    PROFILE_ZONE("tile_refresh");
+
+    if (!refresh_enabled) {
+        display_valid = false;
+        return;
+    }
+
+    unsigned int start = get_time();
+
+    int originX;
+    int originY;
+    map_origin(&originX, &originY);
+
+    int dx = originX - display_origin_x;
+    int dy = originY - display_origin_y;
+
+    int width = rectGetWidth(&buf_rect);
+    int height = rectGetHeight(&buf_rect);
+
+    // Tile bounds are snapped relative to center tile, so they can move
+    // relative to the map. Shadows along map edges would be misplaced in this
+    // case.
+    bool boundsChanged = tile_bounds_rect.ulx - originX != display_bounds.ulx
+        || tile_bounds_rect.uly - originY != display_bounds.uly
+        || tile_bounds_rect.lrx - originX != display_bounds.lrx
+        || tile_bounds_rect.lry - originY != display_bounds.lry;
+
+    if (!display_valid
+        || display_elevation != map_elevation
+        || boundsChanged
+        || abs(dx) >= width
+        || abs(dy) >= height) {
+        tile_refresh_display();
+
+        scroll_full_count++;
+        scroll_full_time += elapsed_time(start);
+        return;
+    }
+
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+
+    int copyWidth = width - abs(dx);
+    int copyHeight = height - abs(dy);
+    int srcX = dx < 0 ? -dx : 0;
+    int destX = dx > 0 ? dx : 0;
+
+    if (dy > 0) {
+        // Moving contents down - copy from bottom to top.
+        for (int y = copyHeight - 1; y >= 0; y--) {
+            memmove(buf + buf_full * (y + dy) + destX, buf + buf_full * y + srcX, copyWidth);
+        }
+    } else {
+        for (int y = 0; y < copyHeight; y++) {
+            memmove(buf + buf_full * y + destX, buf + buf_full * (y - dy) + srcX, copyWidth);
+        }
+    }
+
+    tile_refresh_begin_batch();
+
+    Rect strip;
+
+    // Newly exposed rows.
+    int exposedTop = 0;
+    int exposedBottom = height - 1;
+    if (dy != 0) {
+        strip.ulx = 0;
+        strip.lrx = width - 1;
+        if (dy > 0) {
+            strip.uly = 0;
+            strip.lry = dy - 1;
+            exposedTop = dy;
+        } else {
+            strip.uly = height + dy;
+            strip.lry = height - 1;
+            exposedBottom = height + dy - 1;
+        }
+        tile_refresh(&strip, map_elevation);
+    }
+
+    // Newly exposed columns (excluding rows which were rendered above).
+    if (dx != 0) {
+        strip.uly = exposedTop;
+        strip.lry = exposedBottom;
+        if (dx > 0) {
+            strip.ulx = 0;
+            strip.lrx = dx - 1;
+        } else {
+            strip.ulx = width + dx;
+            strip.lrx = width - 1;
+        }
+        tile_refresh(&strip, map_elevation);
     }
+
+    // Entire window contents moved.
+    tile_blit(&buf_rect);
+    tile_refresh_end_batch();
+
+    display_state_update();
+
+    scroll_shift_count++;
+    scroll_shift_time += elapsed_time(start);
 }
 
 // 0x49DEDC
@@ -562,8 +893,8 @@ int tile_set_center(int tile, int flags)
     tile_update_bounds_rect();
 
     if ((flags & TILE_SET_CENTER_REFRESH_WINDOW) != 0) {
-        // NOTE: Uninline.
-        tile_refresh_display();
+        // CE: Shift display contents instead of full refresh when possible.
+        tile_refresh_scrolled();
     }
 
     return 0;
@@ -589,7 +920,7 @@ static void refresh_mapper(Rect* rect, int elevation)
     obj_render_pre_roof(&rectToUpdate, elevation);
     square_render_roof(&rectToUpdate, elevation);
     obj_render_post_roof(&rectToUpdate, elevation);
-    blit(&rectToUpdate);
+    tile_blit(&rectToUpdate);
 }
 
 // 0x49E1CC
@@ -607,12 +938,28 @@ static void refresh_game(Rect* rect, int elevation)
         buf_full,
         0);
 
-    square_render_floor(&rectToUpdate, elevation);
-    obj_render_pre_roof(&rectToUpdate, elevation);
-    square_render_roof(&rectToUpdate, elevation);
-    bounds_render(&rectToUpdate, elevation);
-    obj_render_post_roof(&rectToUpdate, elevation);
-    blit(&rectToUpdate);
+    {
+        PROFILE_ZONE("floor_render");
+        square_render_floor(&rectToUpdate, elevation);
+    }
+
+    {
+        PROFILE_ZONE("obj_render");
+        obj_render_pre_roof(&rectToUpdate, elevation);
+    }
+
+    {
+        PROFILE_ZONE("roof_render");
+        square_render_roof(&rectToUpdate, elevation);
+        bounds_render(&rectToUpdate, elevation);
+    }
+
+    {
+        PROFILE_ZONE("obj_render");
+        obj_render_post_roof(&rectToUpdate, elevation);
+    }
+
+    tile_blit(&rectToUpdate);
 }
 
 // 0x49E218
@@ -1211,28 +1558,44 @@ void square_render_roof(Rect* rect, int elevation)
 }
 
 // 0x49EDC0
+//
+// CE: Shows the roof region containing given square. Original implementation
+// was recursive flood fill, now it flips flags of the precomputed region.
 static void roof_fill_on(int x, int y, int elevation)
 {
-    if (x >= 0 && x < square_width && y >= 0 && y < square_length) {
-        int squareTileIndex = square_width * y + x;
-        int squareTile = squares[elevation]->field_0[squareTileIndex];
-        int roof = (squareTile >> 16) & 0xFFFF;
-
-        int id = roof & 0xFFF;
-        if (art_id(OBJ_TYPE_TILE, id, 0, 0, 0) != art_id(OBJ_TYPE_TILE, 1, 0, 0, 0)) {
-            int flag = (roof & 0xF000) >> 12;
-            if ((flag & 0x01) != 0) {
-                flag &= ~0x01;
-
-                squares[elevation]->field_0[squareTileIndex] = (squareTile & 0xFFFF) | (((flag << 12) | id) << 16);
-
-                roof_fill_on(x - 1, y, elevation);
-                roof_fill_on(x + 1, y, elevation);
-                roof_fill_on(x, y - 1, elevation);
-                roof_fill_on(x, y + 1, elevation);
+    if (x < 0 || x >= square_width || y < 0 || y >= square_length) {
+        return;
+    }
+
+    int* field_0 = squares[elevation]->field_0;
+    int squareTileIndex = square_width * y + x;
+    if (!roof_present(squareTileIndex, elevation) || (((field_0[squareTileIndex] >> 28) & 0x01) == 0)) {
+        return;
+    }
+
+    RoofRegion* region = roof_region_at(x, y, elevation);
+    int* regionSquares = roof_regions[elevation].squares;
+
+    // Flood fill only passes through hidden squares, so region is shown
+    // as a whole only if it is entirely hidden - which is the case unless
+    // roofs were toggled partially by other means.
+    if (region != NULL) {
+        int index;
+        for (index = 0; index < region->count; index++) {
+            if (((field_0[regionSquares[region->start + index]] >> 28) & 0x01) == 0) {
+                break;
+            }
+        }
+
+        if (index == region->count) {
+            for (index = 0; index < region->count; index++) {
+                field_0[regionSquares[region->start + index]] &= ~(0x01 << 28);
             }
+            return;
         }
     }
+
+    roof_flood_fill(x, y, elevation, 0x01, 0x01, false);
 }
 
 // 0x49EEC4
@@ -1246,28 +1609,309 @@ void tile_fill_roof(int x, int y, int elevation, bool on)
 }
 
 // 0x49EECC
+//
+// CE: Hides the roof region containing given square (see `roof_fill_on`).
 static void roof_fill_off(int x, int y, int elevation)
 {
-    if (x >= 0 && x < square_width && y >= 0 && y < square_length) {
-        int squareTileIndex = square_width * y + x;
-        int squareTile = squares[elevation]->field_0[squareTileIndex];
-        int roof = (squareTile >> 16) & 0xFFFF;
-
-        int id = roof & 0xFFF;
-        if (art_id(OBJ_TYPE_TILE, id, 0, 0, 0) != art_id(OBJ_TYPE_TILE, 1, 0, 0, 0)) {
-            int flag = (roof & 0xF000) >> 12;
-            if ((flag & 0x03) == 0) {
-                flag |= 0x01;
-
-                squares[elevation]->field_0[squareTileIndex] = (squareTile & 0xFFFF) | (((flag << 12) | id) << 16);
-
-                roof_fill_off(x - 1, y, elevation);
-                roof_fill_off(x + 1, y, elevation);
-                roof_fill_off(x, y - 1, elevation);
-                roof_fill_off(x, y + 1, elevation);
+    if (x < 0 || x >= square_width || y < 0 || y >= square_length) {
+        return;
+    }
+
+    int* field_0 = squares[elevation]->field_0;
+    int squareTileIndex = square_width * y + x;
+    if (!roof_present(squareTileIndex, elevation) || (((field_0[squareTileIndex] >> 28) & 0x03) != 0)) {
+        return;
+    }
+
+    RoofRegion* region = roof_region_at(x, y, elevation);
+    int* regionSquares = roof_regions[elevation].squares;
+
+    if (region != NULL) {
+        int index;
+        for (index = 0; index < region->count; index++) {
+            if (((field_0[regionSquares[region->start + index]] >> 28) & 0x03) != 0) {
+                break;
+            }
+        }
+
+        if (index == region->count) {
+            for (index = 0; index < region->count; index++) {
+                field_0[regionSquares[region->start + index]] |= 0x01 << 28;
+            }
+            return;
+        }
+    }
+
+    roof_flood_fill(x, y, elevation, 0x03, 0x00, true);
+}
+
+// Returns true if square has roof tile.
+static bool roof_present(int squareTile, int elevation)
+{
+    return art_id(OBJ_TYPE_TILE, (squares[elevation]->field_0[squareTile] >> 16) & 0xFFF, 0, 0, 0) != art_id(OBJ_TYPE_TILE, 1, 0, 0, 0);
+}
+
+// Returns roof region containing given square, or NULL if there is no roof
+// at this square or regions cannot be built.
+static RoofRegion* roof_region_at(int x, int y, int elevation)
+{
+    RoofRegionMap* regionMap = &(roof_regions[elevation]);
+    if (!regionMap->valid) {
+        if (roof_regions_build(elevation) == -1) {
+            return NULL;
+        }
+    }
+
+    int id = regionMap->ids[square_width * y + x];
+    if (id == 0) {
+        return NULL;
+    }
+
+    return &(regionMap->regions[id - 1]);
+}
+
+// Labels connected roof squares of the given elevation. Regions do not
+// depend on roof visibility flags, so they stay valid until squares are
+// reloaded.
+static int roof_regions_build(int elevation)
+{
+    RoofRegionMap* regionMap = &(roof_regions[elevation]);
+
+    if (regionMap->ids == NULL) {
+        regionMap->ids = (unsigned short*)mem_malloc(sizeof(*regionMap->ids) * square_size);
+        if (regionMap->ids == NULL) {
+            return -1;
+        }
+    }
+
+    if (regionMap->squares == NULL) {
+        regionMap->squares = (int*)mem_malloc(sizeof(*regionMap->squares) * square_size);
+        if (regionMap->squares == NULL) {
+            return -1;
+        }
+    }
+
+    memset(regionMap->ids, 0, sizeof(*regionMap->ids) * square_size);
+
+    int* field_0 = squares[elevation]->field_0;
+    int emptyId = art_id(OBJ_TYPE_TILE, 1, 0, 0, 0);
+    int regionCapacity = 0;
+    int squareCount = 0;
+
+    regionMap->regionCount = 0;
+
+    for (int squareTile = 0; squareTile < square_size; squareTile++) {
+        if (regionMap->ids[squareTile] != 0) {
+            continue;
+        }
+
+        if (art_id(OBJ_TYPE_TILE, (field_0[squareTile] >> 16) & 0xFFF, 0, 0, 0) == emptyId) {
+            continue;
+        }
+
+        if (regionMap->regionCount == regionCapacity) {
+            int newCapacity = regionCapacity != 0 ? regionCapacity * 2 : 64;
+            RoofRegion* regions = (RoofRegion*)mem_realloc(regionMap->regions, sizeof(*regions) * newCapacity);
+            if (regions == NULL) {
+                regionMap->regionCount = 0;
+                return -1;
             }
+
+            regionMap->regions = regions;
+            regionCapacity = newCapacity;
+        }
+
+        // Region ids are 16-bit.
+        if (regionMap->regionCount == 0xFFFF) {
+            return -1;
+        }
+
+        unsigned short id = regionMap->regionCount + 1;
+        RoofRegion* region = &(regionMap->regions[regionMap->regionCount++]);
+        region->start = squareCount;
+        region->minX = square_width;
+        region->minY = square_length;
+        region->maxX = -1;
+        region->maxY = -1;
+
+        // Breadth-first walk, region squares list doubles as queue.
+        regionMap->ids[squareTile] = id;
+        regionMap->squares[squareCount++] = squareTile;
+
+        for (int head = region->start; head < squareCount; head++) {
+            int current = regionMap->squares[head];
+            int x = current % square_width;
+            int y = current / square_width;
+
+            region->minX = std::min(region->minX, x);
+            region->minY = std::min(region->minY, y);
+            region->maxX = std::max(region->maxX, x);
+            region->maxY = std::max(region->maxY, y);
+
+            int neighbors[4];
+            int neighborCount = 0;
+            if (x > 0) neighbors[neighborCount++] = current - 1;
+            if (x < square_width - 1) neighbors[neighborCount++] = current + 1;
+            if (y > 0) neighbors[neighborCount++] = current - square_width;
+            if (y < square_length - 1) neighbors[neighborCount++] = current + square_width;
+
+            for (int index = 0; index < neighborCount; index++) {
+                int neighbor = neighbors[index];
+                if (regionMap->ids[neighbor] == 0
+                    && art_id(OBJ_TYPE_TILE, (field_0[neighbor] >> 16) & 0xFFF, 0, 0, 0) != emptyId) {
+                    regionMap->ids[neighbor] = id;
+                    regionMap->squares[squareCount++] = neighbor;
+                }
+            }
+        }
+
+        region->count = squareCount - region->start;
+    }
+
+    regionMap->valid = true;
+
+    return 0;
+}
+
+static void roof_regions_free()
+{
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        RoofRegionMap* regionMap = &(roof_regions[elevation]);
+        if (regionMap->ids != NULL) {
+            mem_free(regionMap->ids);
+            regionMap->ids = NULL;
+        }
+
+        if (regionMap->squares != NULL) {
+            mem_free(regionMap->squares);
+            regionMap->squares = NULL;
+        }
+
+        if (regionMap->regions != NULL) {
+            mem_free(regionMap->regions);
+            regionMap->regions = NULL;
+        }
+
+        regionMap->regionCount = 0;
+        regionMap->valid = false;
+    }
+}
+
+// Iterative version of the original flood fill, used when region is only
+// partially toggled. Visits roof squares whose flags (masked with `mask`)
+// equal `match`, setting or clearing "hidden" flag.
+static void roof_flood_fill(int x, int y, int elevation, int mask, int match, bool set)
+{
+    int* stack = (int*)mem_malloc(sizeof(*stack) * square_size);
+    if (stack == NULL) {
+        return;
+    }
+
+    int* field_0 = squares[elevation]->field_0;
+    int stackSize = 0;
+
+    stack[stackSize++] = square_width * y + x;
+    if (set) {
+        field_0[stack[0]] |= 0x01 << 28;
+    } else {
+        field_0[stack[0]] &= ~(0x01 << 28);
+    }
+
+    while (stackSize > 0) {
+        int current = stack[--stackSize];
+        int currentX = current % square_width;
+        int currentY = current / square_width;
+
+        int neighbors[4];
+        int neighborCount = 0;
+        if (currentX > 0) neighbors[neighborCount++] = current - 1;
+        if (currentX < square_width - 1) neighbors[neighborCount++] = current + 1;
+        if (currentY > 0) neighbors[neighborCount++] = current - square_width;
+        if (currentY < square_length - 1) neighbors[neighborCount++] = current + square_width;
+
+        for (int index = 0; index < neighborCount; index++) {
+            int neighbor = neighbors[index];
+            int roof = (field_0[neighbor] >> 16) & 0xFFFF;
+            if (art_id(OBJ_TYPE_TILE, roof & 0xFFF, 0, 0, 0) == art_id(OBJ_TYPE_TILE, 1, 0, 0, 0)) {
+                continue;
+            }
+
+            if ((((roof & 0xF000) >> 12) & mask) != match) {
+                continue;
+            }
+
+            // Flag is updated when pushed so every square is pushed once.
+            if (set) {
+                field_0[neighbor] |= 0x01 << 28;
+            } else {
+                field_0[neighbor] &= ~(0x01 << 28);
+            }
+
+            stack[stackSize++] = neighbor;
+        }
+    }
+
+    mem_free(stack);
+}
+
+// CE: Rebuilds roof regions after squares of every elevation are loaded.
+void tile_roof_regions_build()
+{
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        roof_regions[elevation].valid = false;
+        roof_regions_build(elevation);
+    }
+}
+
+// CE: Marks roof regions as outdated (squares are about to change).
+void tile_roof_regions_invalidate()
+{
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        roof_regions[elevation].valid = false;
+    }
+}
+
+// CE: Obtains screen rect covered by roof region containing given square.
+// Returns -1 if there is no roof at this square.
+int tile_roof_region_rect(int x, int y, int elevation, Rect* rect)
+{
+    if (x < 0 || x >= square_width || y < 0 || y >= square_length) {
+        return -1;
+    }
+
+    RoofRegion* region = roof_region_at(x, y, elevation);
+    if (region == NULL) {
+        return -1;
+    }
+
+    // Roof tile position is linear in square coordinates, so the extremes
+    // are at the corners of the region bounds.
+    int corners[4] = {
+        square_width * region->minY + region->minX,
+        square_width * region->minY + region->maxX,
+        square_width * region->maxY + region->minX,
+        square_width * region->maxY + region->maxX,
+    };
+
+    for (int index = 0; index < 4; index++) {
+        int screenX;
+        int screenY;
+        square_coord_roof(corners[index], &screenX, &screenY, elevation);
+
+        Rect cornerRect;
+        cornerRect.ulx = screenX;
+        cornerRect.uly = screenY;
+        cornerRect.lrx = screenX + ROOF_TILE_WIDTH - 1;
+        cornerRect.lry = screenY + ROOF_TILE_HEIGHT - 1;
+
+        if (index == 0) {
+            *rect = cornerRect;
+        } else {
+            rect_min_bound(rect, &cornerRect, rect);
         }
     }
+
+    return 0;
 }
 
 // 0x49EFD0
@@ -1383,22 +2027,34 @@ static void roof_draw(int fid, int x, int y, Rect* rect, int light)
 // 0x49F3EC
 void square_render_floor(Rect* rect, int elevation)
 {
-    int minY;
-    int maxX;
-    int maxY;
-    int minX;
-    int temp;
-
     // CE: Constrain rect to tile bounds so that we don't draw outside.
     Rect constrainedRect = *rect;
     if (tile_inside_bound(&constrainedRect) != 0) {
         return;
     }
 
-    square_xy(constrainedRect.ulx, constrainedRect.uly, elevation, &temp, &minY);
-    square_xy(constrainedRect.lrx, constrainedRect.uly, elevation, &minX, &temp);
-    square_xy(constrainedRect.ulx, constrainedRect.lry, elevation, &maxX, &temp);
-    square_xy(constrainedRect.lrx, constrainedRect.lry, elevation, &temp, &maxY);
+    if (floor_cache_capacity != 0) {
+        floor_cache_render(&constrainedRect, elevation);
+        return;
+    }
+
+    square_render_floor_into(&constrainedRect, elevation, buf, buf_full, &buf_rect);
+}
+
+// Renders floor squares intersecting `rect` (in screen coordinates) into
+// `dest` buffer which represents `destRect` area of the screen.
+static void square_render_floor_into(Rect* rect, int elevation, unsigned char* dest, int destPitch, Rect* destRect)
+{
+    int minY;
+    int maxX;
+    int maxY;
+    int minX;
+    int temp;
+
+    square_xy(rect->ulx, rect->uly, elevation, &temp, &minY);
+    square_xy(rect->lrx, rect->uly, elevation, &minX, &temp);
+    square_xy(rect->ulx, rect->lry, elevation, &maxX, &temp);
+    square_xy(rect->lrx, rect->lry, elevation, &temp, &maxY);
 
     if (minX < 0) {
         minX = 0;
@@ -1416,6 +2072,16 @@ void square_render_floor(Rect* rect, int elevation)
         minY = square_length - 1;
     }
 
+    // CE: Rect is not necessarily constrained to tile bounds when rendering
+    // floor cache chunks.
+    if (maxX >= square_width) {
+        maxX = square_width - 1;
+    }
+
+    if (maxY >= square_length) {
+        maxY = square_length - 1;
+    }
+
     light_get_ambient();
 
     int baseSquareTile = square_width * minY;
@@ -1429,7 +2095,7 @@ void square_render_floor(Rect* rect, int elevation)
                 int tileScreenY;
                 square_coord(squareTile, &tileScreenX, &tileScreenY, elevation);
                 int fid = art_id(OBJ_TYPE_TILE, frmId & 0xFFF, 0, 0, 0);
-                floor_draw(fid, tileScreenX, tileScreenY, &constrainedRect);
+                floor_draw_into(fid, tileScreenX, tileScreenY, rect, dest, destPitch, destRect);
             }
         }
         baseSquareTile += square_width;
@@ -1528,7 +2194,7 @@ void grid_draw(int tile, int elevation)
     rect.lry = rect.uly + 16 - 1;
     if (rect_inside_bound(&rect, &buf_rect, &rect) != -1) {
         draw_grid(tile, elevation, &rect);
-        blit(&rect);
+        tile_blit(&rect);
     }
 }
 
@@ -1553,7 +2219,7 @@ void draw_grid(int tile, int elevation, Rect* rect)
         return;
     }
 
-    if (obj_blocking_at(NULL, tile, elevation) != NULL) {
+    if (tile_is_blocked(tile, elevation)) {
         trans_buf_to_buf(tile_grid_blocked + 32 * (r.uly - y) + (r.ulx - x),
             r.lrx - r.ulx + 1,
             r.lry - r.uly + 1,
@@ -1587,6 +2253,13 @@ void draw_grid(int tile, int elevation, Rect* rect)
 
 // 0x49FB64
 void floor_draw(int fid, int x, int y, Rect* rect)
+{
+    floor_draw_into(fid, x, y, rect, buf, buf_full, &buf_rect);
+}
+
+// Draws floor tile at `x`, `y` (in screen coordinates) clipped to `rect` into
+// `dest` buffer which represents `destRect` area of the screen.
+static void floor_draw_into(int fid, int x, int y, Rect* rect, unsigned char* dest, int destPitch, Rect* destRect)
 {
     if (art_get_disable(FID_TYPE(fid)) != 0) {
         return;
@@ -1614,23 +2287,23 @@ void floor_draw(int fid, int x, int y, Rect* rect)
     int savedX = x;
     int savedY = y;
 
-    if (left < 0) {
-        left = 0;
+    if (left < destRect->ulx) {
+        left = destRect->ulx;
     }
 
-    if (top < 0) {
-        top = 0;
+    if (top < destRect->uly) {
+        top = destRect->uly;
     }
 
-    if (left + width > buf_width) {
-        width = buf_width - left;
+    if (left + width > destRect->lrx + 1) {
+        width = destRect->lrx + 1 - left;
     }
 
-    if (top + height > buf_length) {
-        height = buf_length - top;
+    if (top + height > destRect->lry + 1) {
+        height = destRect->lry + 1 - top;
     }
 
-    if (x >= buf_width || x > rect->lrx || y >= buf_length || y > rect->lry) goto out;
+    if (x > destRect->lrx || x > rect->lrx || y > destRect->lry || y > rect->lry) goto out;
 
     frameWidth = art_frame_width(art, 0, 0);
     frameHeight = art_frame_length(art, 0, 0);
@@ -1688,7 +2361,7 @@ void floor_draw(int fid, int x, int y, Rect* rect)
 
         if (v23 == 9) {
             unsigned char* frame_data = art_frame_data(art, 0, 0);
-            dark_trans_buf_to_buf(frame_data + frameWidth * v78 + v79, v77, v76, frameWidth, buf, x, y, buf_full, verticies[0].intensity);
+            dark_trans_buf_to_buf(frame_data + frameWidth * v78 + v79, v77, v76, frameWidth, dest, x - destRect->ulx, y - destRect->uly, destPitch, verticies[0].intensity);
             goto out;
         }
 
@@ -1800,11 +2473,11 @@ void floor_draw(int fid, int x, int y, Rect* rect)
             }
         }
 
-        unsigned char* v66 = buf + buf_full * y + x;
+        unsigned char* v66 = dest + destPitch * (y - destRect->uly) + (x - destRect->ulx);
         unsigned char* v67 = art_frame_data(art, 0, 0) + frameWidth * v78 + v79;
         int* v68 = &(intensity_map[160 + 80 * v78]) + v79;
         int v86 = frameWidth - v77;
-        int v85 = buf_full - v77;
+        int v85 = destPitch - v77;
         int v87 = 80 - v77;
 
         while (--v76 != -1) {
@@ -1970,19 +2643,13 @@ int tile_scroll_to(int tile, int flags)
     }
 
     if ((flags & 0x02) != 0) {
-        // NOTE: Uninline.
-        tile_refresh_display();
+        // CE: Shift display contents instead of full refresh when possible.
+        tile_refresh_scrolled();
     }
 
     return rc;
 }
 
-static Rect tile_bounds_rect;
-static int tile_bounds_left_off;
-static int tile_bounds_top_off;
-static int tile_bounds_right_off;
-static int tile_bounds_bottom_off;
-
 void tile_update_bounds_base()
 {
     int min_x = INT_MAX;
@@ -2175,4 +2842,263 @@ void bounds_render(Rect* rect, int elevation)
     }
 }
 
+// Computes map space origin (screen coordinates of square 0).
+static void map_origin(int* x, int* y)
+{
+    square_coord(0, x, y, map_elevation);
+}
+
+void tile_print_stats()
+{
+    // Counters run for the whole session, sum and percentage don't fit into
+    // 32 bits.
+    unsigned long long floorCacheQueries = (unsigned long long)floor_cache_hits + floor_cache_misses;
+    if (floorCacheQueries != 0) {
+        debug_printf("\nFloor cache: %u hits, %u misses (%.1f%%), %d bytes",
+            floor_cache_hits,
+            floor_cache_misses,
+            floor_cache_hits * 100.0 / floorCacheQueries,
+            floor_cache_capacity * FLOOR_CHUNK_SIZE);
+    }
+
+    if (scroll_shift_count != 0) {
+        debug_printf("\nScroll: %u shifted (avg %u ms), %u full (avg %u ms)",
+            scroll_shift_count,
+            scroll_shift_time / scroll_shift_count,
+            scroll_full_count,
+            scroll_full_count != 0 ? scroll_full_time / scroll_full_count : 0);
+    }
+}
+
+// Rounds division towards negative infinity.
+static inline int floor_cache_div(int value, int divisor)
+{
+    return value >= 0 ? value / divisor : (value + 1) / divisor - 1;
+}
+
+static void floor_cache_free()
+{
+    if (floor_cache != NULL) {
+        for (int index = 0; index < floor_cache_capacity; index++) {
+            if (floor_cache[index].data != NULL) {
+                mem_free(floor_cache[index].data);
+            }
+        }
+
+        mem_free(floor_cache);
+        floor_cache = NULL;
+    }
+
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        floor_cache_dirty[elevation] = false;
+    }
+}
+
+void tile_floor_cache_invalidate(int elevation)
+{
+    if (floor_cache == NULL) {
+        return;
+    }
+
+    for (int index = 0; index < floor_cache_capacity; index++) {
+        FloorChunk* chunk = &(floor_cache[index]);
+        if (elevation == -1 || chunk->elevation == elevation) {
+            chunk->elevation = -1;
+        }
+    }
+
+    if (elevation == -1) {
+        for (int index = 0; index < ELEVATION_COUNT; index++) {
+            floor_cache_dirty[index] = false;
+        }
+    } else if (elevationIsValid(elevation)) {
+        floor_cache_dirty[elevation] = false;
+    }
+}
+
+void tile_floor_cache_invalidate_tile(int elevation, int tile)
+{
+    if (floor_cache == NULL) {
+        return;
+    }
+
+    if (!elevationIsValid(elevation)) {
+        return;
+    }
+
+    Rect rect;
+    if (tile_light_bound(tile, elevation, &rect) != 0) {
+        return;
+    }
+
+    int originX;
+    int originY;
+    map_origin(&originX, &originY);
+    rectOffset(&rect, -originX, -originY);
+
+    // Light changes come in large batches (every tile in light radius), so
+    // just accumulate affected area and apply it on the next floor render.
+    if (floor_cache_dirty[elevation]) {
+        rect_min_bound(&rect, &(floor_cache_dirty_rect[elevation]), &(floor_cache_dirty_rect[elevation]));
+    } else {
+        floor_cache_dirty_rect[elevation] = rect;
+        floor_cache_dirty[elevation] = true;
+    }
+}
+
+// CE: Returns screen area of floor which can be affected by changing light
+// intensity of `tile`.
+int tile_light_bound(int tile, int elevation, Rect* rect)
+{
+    int tileScreenX;
+    int tileScreenY;
+    if (tile_coord(tile, &tileScreenX, &tileScreenY, elevation) != 0) {
+        return -1;
+    }
+
+    rect->ulx = tileScreenX - FLOOR_LIGHT_MARGIN_X;
+    rect->uly = tileScreenY - FLOOR_LIGHT_MARGIN_Y;
+    rect->lrx = tileScreenX + FLOOR_LIGHT_MARGIN_X;
+    rect->lry = tileScreenY + FLOOR_LIGHT_MARGIN_Y;
+
+    return 0;
+}
+
+void tile_floor_cache_get_stats(unsigned int* hits, unsigned int* misses, int* size)
+{
+    *hits = floor_cache_hits;
+    *misses = floor_cache_misses;
+    *size = floor_cache_capacity * FLOOR_CHUNK_SIZE;
+}
+
+// Evicts chunks intersecting accumulated light changes.
+static void floor_cache_flush(int elevation)
+{
+    if (!floor_cache_dirty[elevation]) {
+        return;
+    }
+
+    Rect* dirtyRect = &(floor_cache_dirty_rect[elevation]);
+    int minX = floor_cache_div(dirtyRect->ulx, FLOOR_CHUNK_WIDTH);
+    int minY = floor_cache_div(dirtyRect->uly, FLOOR_CHUNK_HEIGHT);
+    int maxX = floor_cache_div(dirtyRect->lrx, FLOOR_CHUNK_WIDTH);
+    int maxY = floor_cache_div(dirtyRect->lry, FLOOR_CHUNK_HEIGHT);
+
+    for (int index = 0; index < floor_cache_capacity; index++) {
+        FloorChunk* chunk = &(floor_cache[index]);
+        if (chunk->elevation == elevation
+            && chunk->x >= minX && chunk->x <= maxX
+            && chunk->y >= minY && chunk->y <= maxY) {
+            chunk->elevation = -1;
+        }
+    }
+
+    floor_cache_dirty[elevation] = false;
+}
+
+// Returns pre-rendered floor chunk, rendering it if needed. Returns `NULL` if
+// chunk cannot be allocated.
+static unsigned char* floor_cache_get(int elevation, int chunkX, int chunkY, int originX, int originY)
+{
+    if (floor_cache == NULL) {
+        floor_cache = (FloorChunk*)mem_malloc(sizeof(*floor_cache) * floor_cache_capacity);
+        if (floor_cache == NULL) {
+            return NULL;
+        }
+
+        for (int index = 0; index < floor_cache_capacity; index++) {
+            floor_cache[index].elevation = -1;
+            floor_cache[index].mru = 0;
+            floor_cache[index].data = NULL;
+        }
+    }
+
+    floor_cache_clock++;
+
+    FloorChunk* candidate = NULL;
+    for (int index = 0; index < floor_cache_capacity; index++) {
+        FloorChunk* chunk = &(floor_cache[index]);
+        if (chunk->elevation == elevation && chunk->x == chunkX && chunk->y == chunkY) {
+            chunk->mru = floor_cache_clock;
+            floor_cache_hits++;
+            return chunk->data;
+        }
+
+        if (candidate == NULL
+            || (candidate->elevation != -1 && (chunk->elevation == -1 || chunk->mru < candidate->mru))) {
+            candidate = chunk;
+        }
+    }
+
+    floor_cache_misses++;
+
+    if (candidate->data == NULL) {
+        candidate->data = (unsigned char*)mem_malloc(FLOOR_CHUNK_SIZE);
+        if (candidate->data == NULL) {
+            return NULL;
+        }
+    }
+
+    candidate->elevation = elevation;
+    candidate->x = chunkX;
+    candidate->y = chunkY;
+    candidate->mru = floor_cache_clock;
+
+    Rect chunkRect;
+    chunkRect.ulx = chunkX * FLOOR_CHUNK_WIDTH + originX;
+    chunkRect.uly = chunkY * FLOOR_CHUNK_HEIGHT + originY;
+    chunkRect.lrx = chunkRect.ulx + FLOOR_CHUNK_WIDTH - 1;
+    chunkRect.lry = chunkRect.uly + FLOOR_CHUNK_HEIGHT - 1;
+
+    buf_fill(candidate->data, FLOOR_CHUNK_WIDTH, FLOOR_CHUNK_HEIGHT, FLOOR_CHUNK_WIDTH, 0);
+    square_render_floor_into(&chunkRect, elevation, candidate->data, FLOOR_CHUNK_WIDTH, &chunkRect);
+
+    return candidate->data;
+}
+
+// Copies floor from pre-rendered chunks into `rect` (in screen coordinates).
+static void floor_cache_render(Rect* rect, int elevation)
+{
+    light_flush();
+    floor_cache_flush(elevation);
+
+    int originX;
+    int originY;
+    map_origin(&originX, &originY);
+
+    int minX = floor_cache_div(rect->ulx - originX, FLOOR_CHUNK_WIDTH);
+    int minY = floor_cache_div(rect->uly - originY, FLOOR_CHUNK_HEIGHT);
+    int maxX = floor_cache_div(rect->lrx - originX, FLOOR_CHUNK_WIDTH);
+    int maxY = floor_cache_div(rect->lry - originY, FLOOR_CHUNK_HEIGHT);
+
+    for (int chunkY = minY; chunkY <= maxY; chunkY++) {
+        for (int chunkX = minX; chunkX <= maxX; chunkX++) {
+            Rect chunkRect;
+            chunkRect.ulx = chunkX * FLOOR_CHUNK_WIDTH + originX;
+            chunkRect.uly = chunkY * FLOOR_CHUNK_HEIGHT + originY;
+            chunkRect.lrx = chunkRect.ulx + FLOOR_CHUNK_WIDTH - 1;
+            chunkRect.lry = chunkRect.uly + FLOOR_CHUNK_HEIGHT - 1;
+
+            Rect intersection;
+            if (rect_inside_bound(&chunkRect, rect, &intersection) != 0) {
+                continue;
+            }
+
+            unsigned char* data = floor_cache_get(elevation, chunkX, chunkY, originX, originY);
+            if (data == NULL) {
+                // Out of memory - render directly.
+                square_render_floor_into(&intersection, elevation, buf, buf_full, &buf_rect);
+                continue;
+            }
+
+            buf_to_buf(data + FLOOR_CHUNK_WIDTH * (intersection.uly - chunkRect.uly) + (intersection.ulx - chunkRect.ulx),
+                rectGetWidth(&intersection),
+                rectGetHeight(&intersection),
+                FLOOR_CHUNK_WIDTH,
+                buf + buf_full * intersection.uly + intersection.ulx,
+                buf_full);
+        }
+    }
+}
+
 } // namespace fallout
@@ -23,8 +23,11 @@ void tile_reset();
 void tile_exit();
 void tile_disable_refresh();
 void tile_enable_refresh();
+void tile_display_invalidate();
 void tile_refresh_rect(Rect* rect, int elevation);
 void tile_refresh_display();
+void tile_refresh_begin_batch();
+void tile_refresh_end_batch();
 int tile_set_center(int tile, int flags);
 void tile_toggle_roof(int a1);
 int tile_roof_visible();
@@ -50,6 +53,9 @@ void square_xy(int screenX, int screenY, int elevation, int* coordX, int* coordY
 void square_xy_roof(int screenX, int screenY, int elevation, int* coordX, int* coordY);
 void square_render_roof(Rect* rect, int elevation);
 void tile_fill_roof(int x, int y, int elevation, bool on);
+void tile_roof_regions_build();
+void tile_roof_regions_invalidate();
+int tile_roof_region_rect(int x, int y, int elevation, Rect* rect);
 void square_render_floor(Rect* rect, int elevation);
 bool square_roof_intersect(int x, int y, int elevation);
 void grid_toggle();
@@ -69,6 +75,12 @@ int tile_inside_bound(Rect* rect);
 bool tile_point_inside_bound(int x, int y);
 void bounds_render(Rect* rect, int elevation);
 
+void tile_floor_cache_invalidate(int elevation);
+void tile_floor_cache_invalidate_tile(int elevation, int tile);
+int tile_light_bound(int tile, int elevation, Rect* rect);
+void tile_floor_cache_get_stats(unsigned int* hits, unsigned int* misses, int* size);
+void tile_print_stats();
+
 } // namespace fallout
 
 #endif /* FALLOUT_GAME_TILE_H_ */
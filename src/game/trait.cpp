@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 
+#include "game/combat.h"
 #include "game/game.h"
 #include "game/message.h"
 #include "game/object.h"
@@ -129,6 +130,9 @@ void trait_set(int trait1, int trait2)
 {
     pc_trait[0] = trait1;
     pc_trait[1] = trait2;
+
+    // CE: See `determine_to_hit_memo`.
+    combat_to_hit_invalidate();
 }
 
 // Returns selected traits.
@@ -304,9 +304,16 @@ static void movie_MVE_ShowFrame(SDL_Surface* surface, int srcWidth, int srcHeigh
         }
     }
 
+    // CE: Movie frame is blitted directly to the screen, windows refreshed
+    // before it must be composed first to keep drawing order.
+    win_flush_dirty();
+
     SDL_SetSurfacePalette(surface, gSdlSurface->format->palette);
     SDL_BlitSurface(surface, &srcRect, gSdlSurface, &destRect);
 
+    // CE: `destRect` is clipped by the blit.
+    svga_mark_dirty(destRect.x, destRect.y, destRect.w, destRect.h);
+
     // This replaces the removed gSdlTextureSurface logic
     renderPresent();
 }
@@ -1650,6 +1650,7 @@ static void objs_area_turn_on_off(int a1, int a2, int a3, int a4, int enabled)
                     } else {
                         object->flags |= OBJECT_HIDDEN;
                     }
+                    obj_blocking_changed();
                     rect_min_bound(&rect, &object_bounds, &rect);
                 }
             }
@@ -1713,6 +1714,7 @@ static void op_set_obj_visibility(Program* program)
             if (PID_TYPE(obj->pid) == OBJ_TYPE_CRITTER) {
                 obj->flags |= OBJECT_NO_BLOCK;
             }
+            obj_blocking_changed();
 
             tile_refresh_rect(&rect, obj->elevation);
         }
@@ -1723,6 +1725,7 @@ static void op_set_obj_visibility(Program* program)
             }
 
             obj->flags &= ~OBJECT_HIDDEN;
+            obj_blocking_changed();
 
             Rect rect;
             obj_bound(obj, &rect);
@@ -3,13 +3,21 @@
 #include <math.h>
 #include <string.h>
 
+#include <stdio.h>
+
 #include <algorithm>
 
+#include "platform_compat.h"
+#include "plib/gnw/debug.h"
 #include "plib/gnw/input.h"
 #include "plib/gnw/svga.h"
 
 namespace fallout {
 
+// CE: Derived color tables cache file format, see `colorCacheRead`.
+#define COLOR_CACHE_MAGIC 0x4C425443
+#define COLOR_CACHE_VERSION 1
+
 static void* colorOpen(const char* filePath);
 static int colorRead(void* handle, void* buffer, size_t size);
 static int colorClose(void* handle);
@@ -23,6 +31,11 @@ static void setMixTable();
 static void buildBlendTable(unsigned char* ptr, unsigned char ch);
 static void rebuildColorBlendTables();
 static void maxfill();
+static void buildColorTables();
+static unsigned int colorCacheHash();
+static void colorCacheFileName(unsigned int hash, char* dest, size_t size);
+static bool colorCacheRead(unsigned int hash);
+static void colorCacheWrite(unsigned int hash);
 
 // 0x4FE0DC
 static char _aColor_cNoError[] = "color.c: No errors\n";
@@ -60,6 +73,10 @@ static ColorFreeFunc* freePtr = defaultFree;
 // 0x539F00
 static ColorNameMangleFunc* colorNameMangler = NULL;
 
+// CE: Directory of derived color tables cache (see `buildColorTables`),
+// disabled when empty.
+static char colorCacheDirectory[COMPAT_MAX_PATH];
+
 // 0x539F04
 unsigned char cmap[768] = {
     0x3F, 0x3F, 0x3F
@@ -166,6 +183,17 @@ void colorSetNameMangler(ColorNameMangleFunc* c)
     colorNameMangler = c;
 }
 
+// CE: Sets directory where derived color tables are cached between runs.
+void colorSetCacheDirectory(const char* path)
+{
+    if (path != NULL) {
+        strncpy(colorCacheDirectory, path, sizeof(colorCacheDirectory) - 1);
+        colorCacheDirectory[sizeof(colorCacheDirectory) - 1] = '\0';
+    } else {
+        colorCacheDirectory[0] = '\0';
+    }
+}
+
 // 0x4BFE3C
 Color colorMixAdd(Color a, Color b)
 {
@@ -500,11 +528,7 @@ bool loadColorTable(const char* path)
         // NOTE: Uninline.
         colorRead(handle, colorMixMulTable, 0x10000);
     } else {
-        setIntensityTables();
-
-        for (int index = 0; index < 256; index++) {
-            setMixTableColor(index);
-        }
+        buildColorTables();
     }
 
     rebuildColorBlendTables();
@@ -515,6 +539,128 @@ bool loadColorTable(const char* path)
     return true;
 }
 
+// CE: Builds intensity and mix tables for the current palette. Computing
+// them takes a noticeable part of startup on target hardware, so they are
+// cached in `colorCacheDirectory` in a file per palette (keyed by hash of
+// palette and color table).
+static void buildColorTables()
+{
+    unsigned int start = get_time();
+    unsigned int hash = 0;
+
+    if (colorCacheDirectory[0] != '\0') {
+        hash = colorCacheHash();
+        if (colorCacheRead(hash)) {
+            debug_printf("color: tables %08x loaded from cache in %u ms\n", hash, elapsed_time(start));
+            return;
+        }
+    }
+
+    setIntensityTables();
+    setMixTable();
+
+    debug_printf("color: tables computed in %u ms\n", elapsed_time(start));
+
+    if (colorCacheDirectory[0] != '\0') {
+        colorCacheWrite(hash);
+    }
+}
+
+// CE: FNV-1a over everything derived tables depend on.
+static unsigned int colorCacheHash()
+{
+    unsigned int hash = 2166136261U;
+
+    for (int index = 0; index < 256; index++) {
+        hash ^= mappedColor[index];
+        hash *= 16777619U;
+    }
+
+    for (int index = 0; index < 768; index++) {
+        hash ^= cmap[index];
+        hash *= 16777619U;
+    }
+
+    for (int index = 0; index < 32768; index++) {
+        hash ^= colorTable[index];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static void colorCacheFileName(unsigned int hash, char* dest, size_t size)
+{
+    snprintf(dest, size, "%s\\clr%08x.tbl", colorCacheDirectory, hash);
+}
+
+// CE: Reads cached tables directly into `intensityColorTable`,
+// `colorMixAddTable` and `colorMixMulTable`.
+//
+// Cache file layout:
+//   - magic ('CTBL'), version, hash
+//   - palette (768 bytes, guards against hash collisions)
+//   - intensity, mix add and mix mul tables (64 KB each)
+static bool colorCacheRead(unsigned int hash)
+{
+    char path[COMPAT_MAX_PATH];
+    colorCacheFileName(hash, path, sizeof(path));
+
+    FILE* stream = compat_fopen(path, "rb");
+    if (stream == NULL) {
+        return false;
+    }
+
+    unsigned int header[3];
+    unsigned char palette[768];
+    bool success = fread(header, sizeof(header), 1, stream) == 1
+        && header[0] == COLOR_CACHE_MAGIC
+        && header[1] == COLOR_CACHE_VERSION
+        && header[2] == hash
+        && fread(palette, sizeof(palette), 1, stream) == 1
+        && memcmp(palette, cmap, sizeof(palette)) == 0
+        && fread(intensityColorTable, sizeof(intensityColorTable), 1, stream) == 1
+        && fread(colorMixAddTable, sizeof(colorMixAddTable), 1, stream) == 1
+        && fread(colorMixMulTable, sizeof(colorMixMulTable), 1, stream) == 1;
+
+    fclose(stream);
+
+    if (!success) {
+        // Tables might be partially overwritten - caller recomputes them
+        // and replaces stale file.
+        debug_printf("color: ignoring invalid cache %s\n", path);
+    }
+
+    return success;
+}
+
+static void colorCacheWrite(unsigned int hash)
+{
+    char path[COMPAT_MAX_PATH];
+    colorCacheFileName(hash, path, sizeof(path));
+
+    compat_mkdir(colorCacheDirectory);
+
+    FILE* stream = compat_fopen(path, "wb");
+    if (stream == NULL) {
+        return;
+    }
+
+    unsigned int header[3] = { COLOR_CACHE_MAGIC, COLOR_CACHE_VERSION, hash };
+    bool success = fwrite(header, sizeof(header), 1, stream) == 1
+        && fwrite(cmap, sizeof(cmap), 1, stream) == 1
+        && fwrite(intensityColorTable, sizeof(intensityColorTable), 1, stream) == 1
+        && fwrite(colorMixAddTable, sizeof(colorMixAddTable), 1, stream) == 1
+        && fwrite(colorMixMulTable, sizeof(colorMixMulTable), 1, stream) == 1;
+
+    fclose(stream);
+
+    if (!success) {
+        // Don't leave truncated file behind.
+        compat_remove(path);
+    }
+}
+
 // 0x4C063C
 char* colorError()
 {
@@ -740,12 +886,7 @@ bool colorPopColorPalette()
     free(entry);
     colorPaletteStack[tos] = NULL;
 
-    setIntensityTables();
-
-    for (int index = 0; index < 256; index++) {
-        setMixTableColor(index);
-    }
-
+    buildColorTables();
     rebuildColorBlendTables();
 
     return true;
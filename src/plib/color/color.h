@@ -37,6 +37,7 @@ extern unsigned char colorTable[32768];
 
 void colorInitIO(ColorOpenFunc* openProc, ColorReadFunc* readProc, ColorCloseFunc* closeProc);
 void colorSetNameMangler(ColorNameMangleFunc* c);
+void colorSetCacheDirectory(const char* path);
 Color colorMixAdd(Color a, Color b);
 Color colorMixMul(Color a, Color b);
 int calculateColor(int a1, int a2);
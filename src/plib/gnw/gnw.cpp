@@ -1,5 +1,7 @@
 #include "plib/gnw/gnw.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "game/palette.h"
@@ -11,6 +13,7 @@
 #include "plib/gnw/input.h"
 #include "plib/gnw/intrface.h"
 #include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
 #include "plib/gnw/svga.h"
 #include "plib/gnw/text.h"
 #include "plib/gnw/vcr.h"
@@ -20,9 +23,16 @@ namespace fallout {
 
 #define MAX_WINDOW_COUNT 50
 
+#define COMPOSE_MAX_DIRTY_RECTS 32
+
+// Coverage map value for pixels not covered by any window.
+#define COMPOSE_NO_WINDOW 0xFF
+
 static void win_free(int win);
-static void win_clip(Window* window, RectPtr* rectListNodePtr, unsigned char* a3);
 static void refresh_all(Rect* rect, unsigned char* a2);
+static void compose_add_dirty(const Rect* rect);
+static void compose_build_coverage();
+static void compose_rect(Rect* rect, unsigned char* dest, int destPitch);
 static void* colorOpen(const char* path);
 static int colorRead(void* handle, void* buf, size_t count);
 static int colorClose(void* handle);
@@ -69,8 +79,18 @@ static bool buffering;
 // 0x6AC2C0
 static int bk_color;
 
-// 0x6AC2C8
-static int doing_refresh_all;
+// CE: Composition target - screen contents are assembled here before being
+// presented with `scr_blit`.
+static unsigned char* compose_buffer = NULL;
+
+// CE: Index (in `window`) of the topmost opaque window for every screen
+// pixel.
+static unsigned char* compose_coverage = NULL;
+static bool compose_coverage_valid = false;
+
+// CE: Areas refreshed since the last `win_flush_dirty`.
+static Rect compose_dirty[COMPOSE_MAX_DIRTY_RECTS];
+static int compose_dirty_count = 0;
 
 // 0x6AC2CC
 void* GNW_texture;
@@ -140,8 +160,29 @@ int win_init(VideoOptions* video_options, int flags)
         }
     }
 
+    // CE: Window compositor buffers.
+    compose_buffer = (unsigned char*)mem_malloc(rectGetWidth(&scr_size) * rectGetHeight(&scr_size));
+    compose_coverage = (unsigned char*)mem_malloc(rectGetWidth(&scr_size) * rectGetHeight(&scr_size));
+    if (compose_buffer == NULL || compose_coverage == NULL) {
+        svga_exit();
+        if (compose_buffer != NULL) {
+            mem_free(compose_buffer);
+            compose_buffer = NULL;
+        }
+        if (compose_coverage != NULL) {
+            mem_free(compose_coverage);
+            compose_coverage = NULL;
+        }
+        if (screen_buffer != NULL) {
+            mem_free(screen_buffer);
+        }
+        return WINDOW_MANAGER_ERR_NO_MEMORY;
+    }
+
+    compose_coverage_valid = false;
+    compose_dirty_count = 0;
+
     buffering = false;
-    doing_refresh_all = 0;
 
     // DbgPrint("win_init: calling colorInitIO + colorRegisterAlloc\n");
     colorInitIO(colorOpen, colorRead, colorClose);
@@ -251,6 +292,18 @@ void win_exit(void)
                 mem_free(screen_buffer);
             }
 
+            if (compose_buffer != NULL) {
+                mem_free(compose_buffer);
+                compose_buffer = NULL;
+            }
+
+            if (compose_coverage != NULL) {
+                mem_free(compose_coverage);
+                compose_coverage = NULL;
+            }
+
+            compose_dirty_count = 0;
+
             svga_exit();
 
             GNW_input_exit();
@@ -344,6 +397,8 @@ int win_add(int x, int y, int width, int height, int color, int flags)
     win_move(index, x, y);
     w->flags = flags;
 
+    compose_coverage_valid = false;
+
     if ((flags & WINDOW_MOVE_ON_TOP) == 0) {
         v23 = num_windows - 2;
         while (v23 > 0) {
@@ -399,6 +454,8 @@ void win_delete(int win)
 
     num_windows--;
 
+    compose_coverage_valid = false;
+
     // NOTE: Uninline.
     win_refresh_all(&rect);
 }
@@ -719,6 +776,7 @@ void win_show(int win)
 
     if (w->flags & WINDOW_HIDDEN) {
         w->flags &= ~WINDOW_HIDDEN;
+        compose_coverage_valid = false;
         // DbgPrint("win_show: window was hidden, un-hiding\n");
 
         if (v3 == num_windows - 1) {
@@ -740,6 +798,7 @@ void win_show(int win)
 
         window[v3] = w;
         window_index[w->id] = v3;
+        compose_coverage_valid = false;
 
         // DbgPrint("win_show: moved window to top, refreshing\n");
         GNW_win_refresh(w, &(w->rect), NULL);
@@ -769,6 +828,7 @@ void win_hide(int win)
 
     if ((w->flags & WINDOW_HIDDEN) == 0) {
         w->flags |= WINDOW_HIDDEN;
+        compose_coverage_valid = false;
         // DbgPrint("win_hide: window not hidden, calling refresh_all\n");
         refresh_all(&(w->rect), NULL);
     } else {
@@ -823,6 +883,8 @@ void win_move(int win, int x, int y)
     w->rect.lrx = w->width + x - 1;
     w->rect.lry = w->height + y - 1;
 
+    compose_coverage_valid = false;
+
     if ((w->flags & WINDOW_HIDDEN) == 0) {
         GNW_win_refresh(w, &(w->rect), NULL);
 
@@ -869,163 +931,30 @@ void win_draw_rect(int win, const Rect* rect)
 }
 
 // 0x4C3094
+//
+// CE: Instead of clipping `w` against every window above it and blitting
+// each fragment, the affected area is recorded as dirty and composed in a
+// single pass by `win_flush_dirty` (see `compose_rect`).
 void GNW_win_refresh(Window* w, Rect* rect, unsigned char* a3)
 {
-    RectPtr v26, v20, v23, v24;
-    int dest_pitch;
-
-    // TODO: Get rid of this.
-    dest_pitch = 0;
+    PROFILE_ZONE("win_refresh");
 
     if ((w->flags & WINDOW_HIDDEN) != 0) {
         return;
     }
 
-    if ((w->flags & WINDOW_TRANSPARENT) && buffering && !doing_refresh_all) {
-        // TODO: Incomplete.
-    } else {
-        v26 = rect_malloc();
-        if (v26 == NULL) {
-            return;
-        }
-
-        v26->next = NULL;
-
-        v26->rect.ulx = std::max(w->rect.ulx, rect->ulx);
-        v26->rect.uly = std::max(w->rect.uly, rect->uly);
-        v26->rect.lrx = std::min(w->rect.lrx, rect->lrx);
-        v26->rect.lry = std::min(w->rect.lry, rect->lry);
-
-        if (v26->rect.lrx >= v26->rect.ulx && v26->rect.lry >= v26->rect.uly) {
-            if (a3) {
-                dest_pitch = rect->lrx - rect->ulx + 1;
-            }
-
-            win_clip(w, &v26, a3);
-
-            if (w->id) {
-                v20 = v26;
-                while (v20) {
-                    GNW_button_refresh(w, &(v20->rect));
-
-                    if (a3) {
-                        if (buffering && (w->flags & WINDOW_TRANSPARENT)) {
-                            w->blitProc(w->buffer + v20->rect.ulx - w->rect.ulx + (v20->rect.uly - w->rect.uly) * w->width,
-                                v20->rect.lrx - v20->rect.ulx + 1,
-                                v20->rect.lry - v20->rect.uly + 1,
-                                w->width,
-                                a3 + dest_pitch * (v20->rect.uly - rect->uly) + v20->rect.ulx - rect->ulx,
-                                dest_pitch);
-                        } else {
-                            buf_to_buf(
-                                w->buffer + v20->rect.ulx - w->rect.ulx + (v20->rect.uly - w->rect.uly) * w->width,
-                                v20->rect.lrx - v20->rect.ulx + 1,
-                                v20->rect.lry - v20->rect.uly + 1,
-                                w->width,
-                                a3 + dest_pitch * (v20->rect.uly - rect->uly) + v20->rect.ulx - rect->ulx,
-                                dest_pitch);
-                        }
-                    } else {
-                        if (buffering) {
-                            if (w->flags & WINDOW_TRANSPARENT) {
-                                w->blitProc(
-                                    w->buffer + v20->rect.ulx - w->rect.ulx + (v20->rect.uly - w->rect.uly) * w->width,
-                                    v20->rect.lrx - v20->rect.ulx + 1,
-                                    v20->rect.lry - v20->rect.uly + 1,
-                                    w->width,
-                                    screen_buffer + v20->rect.uly * (scr_size.lrx - scr_size.ulx + 1) + v20->rect.ulx,
-                                    scr_size.lrx - scr_size.ulx + 1);
-                            } else {
-                                buf_to_buf(
-                                    w->buffer + v20->rect.ulx - w->rect.ulx + (v20->rect.uly - w->rect.uly) * w->width,
-                                    v20->rect.lrx - v20->rect.ulx + 1,
-                                    v20->rect.lry - v20->rect.uly + 1,
-                                    w->width,
-                                    screen_buffer + v20->rect.uly * (scr_size.lrx - scr_size.ulx + 1) + v20->rect.ulx,
-                                    scr_size.lrx - scr_size.ulx + 1);
-                            }
-                        } else {
-                            scr_blit(
-                                w->buffer + v20->rect.ulx - w->rect.ulx + (v20->rect.uly - w->rect.uly) * w->width,
-                                w->width,
-                                v20->rect.lry - v20->rect.lry + 1,
-                                0,
-                                0,
-                                v20->rect.lrx - v20->rect.ulx + 1,
-                                v20->rect.lry - v20->rect.uly + 1,
-                                v20->rect.ulx,
-                                v20->rect.uly);
-                        }
-                    }
-
-                    v20 = v20->next;
-                }
-            } else {
-                rectdata* v16 = v26;
-                while (v16 != NULL) {
-                    int width = v16->rect.lrx - v16->rect.ulx + 1;
-                    int height = v16->rect.lry - v16->rect.uly + 1;
-                    unsigned char* buf = (unsigned char*)mem_malloc(width * height);
-                    if (buf != NULL) {
-                        buf_fill(buf, width, height, width, bk_color);
-                        if (dest_pitch != 0) {
-                            buf_to_buf(
-                                buf,
-                                width,
-                                height,
-                                width,
-                                a3 + dest_pitch * (v16->rect.uly - rect->uly) + v16->rect.ulx - rect->ulx,
-                                dest_pitch);
-                        } else {
-                            if (buffering) {
-                                buf_to_buf(buf,
-                                    width,
-                                    height,
-                                    width,
-                                    screen_buffer + v16->rect.uly * (scr_size.lrx - scr_size.ulx + 1) + v16->rect.ulx,
-                                    scr_size.lrx - scr_size.ulx + 1);
-                            } else {
-                                scr_blit(buf, width, height, 0, 0, width, height, v16->rect.ulx, v16->rect.uly);
-                            }
-                        }
-
-                        mem_free(buf);
-                    }
-                    v16 = v16->next;
-                }
-            }
-
-            v23 = v26;
-            while (v23) {
-                v24 = v23->next;
-
-                if (buffering && !a3) {
-                    scr_blit(
-                        screen_buffer + v23->rect.ulx + (scr_size.lrx - scr_size.ulx + 1) * v23->rect.uly,
-                        scr_size.lrx - scr_size.ulx + 1,
-                        v23->rect.lry - v23->rect.uly + 1,
-                        0,
-                        0,
-                        v23->rect.lrx - v23->rect.ulx + 1,
-                        v23->rect.lry - v23->rect.uly + 1,
-                        v23->rect.ulx,
-                        v23->rect.uly);
-                }
-
-                rect_free(v23);
-
-                v23 = v24;
-            }
+    Rect dirtyRect;
+    if (rect_inside_bound(rect, &(w->rect), &dirtyRect) != 0) {
+        return;
+    }
 
-            if (!doing_refresh_all && a3 == NULL && mouse_hidden() == 0) {
-                if (mouse_in(rect->ulx, rect->uly, rect->lrx, rect->lry)) {
-                    mouse_show();
-                }
-            }
-        } else {
-            rect_free(v26);
-        }
+    if (a3 != NULL) {
+        int destPitch = rect->lrx - rect->ulx + 1;
+        compose_rect(&dirtyRect, a3 + destPitch * (dirtyRect.uly - rect->uly) + dirtyRect.ulx - rect->ulx, destPitch);
+        return;
     }
+
+    compose_add_dirty(&dirtyRect);
 }
 
 // 0x4C3654
@@ -1036,39 +965,6 @@ void win_refresh_all(Rect* rect)
     }
 }
 
-// 0x4C3668
-static void win_clip(Window* w, RectPtr* rectListNodePtr, unsigned char* a3)
-{
-    int win;
-
-    for (win = window_index[w->id] + 1; win < num_windows; win++) {
-        if (*rectListNodePtr == NULL) {
-            break;
-        }
-
-        // TODO: Review.
-        Window* w = window[win];
-        if (!(w->flags & WINDOW_HIDDEN)) {
-            if (!buffering || !(w->flags & WINDOW_TRANSPARENT)) {
-                rect_clip_list(rectListNodePtr, &(w->rect));
-            } else {
-                if (!doing_refresh_all) {
-                    GNW_win_refresh(w, &(w->rect), NULL);
-                    rect_clip_list(rectListNodePtr, &(w->rect));
-                }
-            }
-        }
-    }
-
-    if (a3 == screen_buffer || a3 == NULL) {
-        if (mouse_hidden() == 0) {
-            Rect rect;
-            mouse_get_rect(&rect);
-            rect_clip_list(rectListNodePtr, &rect);
-        }
-    }
-}
-
 // 0x4C3714
 void win_drag(int win)
 {
@@ -1107,20 +1003,239 @@ void win_get_mouse_buf(unsigned char* a1)
 }
 
 // 0x4C38CC
+//
+// CE: Composes all windows in one pass. When `a2` is NULL the area is
+// presented immediately together with everything accumulated so far, since
+// callers (mouse, screenshots) rely on the screen being up to date on return.
 static void refresh_all(Rect* rect, unsigned char* a2)
 {
-    doing_refresh_all = 1;
+    Rect dirtyRect;
+    if (rect_inside_bound(rect, &scr_size, &dirtyRect) != 0) {
+        return;
+    }
+
+    if (a2 != NULL) {
+        int destPitch = rect->lrx - rect->ulx + 1;
+        compose_rect(&dirtyRect, a2 + destPitch * (dirtyRect.uly - rect->uly) + dirtyRect.ulx - rect->ulx, destPitch);
+        return;
+    }
+
+    compose_add_dirty(&dirtyRect);
+    win_flush_dirty();
+}
+
+// CE: Composes and presents all areas refreshed since the last flush. Every
+// screen pixel is written at most once regardless of number of windows
+// stacked above it.
+void win_flush_dirty()
+{
+    if (!GNW_win_init_flag) {
+        return;
+    }
+
+    if (compose_dirty_count == 0) {
+        return;
+    }
+
+    PROFILE_ZONE("win_compose");
+
+    int screenWidth = rectGetWidth(&scr_size);
+
+    bool mouseVisible = !mouse_hidden();
+    bool mouseDirty = false;
+    Rect mouseRect;
+    if (mouseVisible) {
+        mouse_get_rect(&mouseRect);
+    }
+
+    // Mouse can be re-drawn below, which composes windows again, so dirty
+    // list is consumed before presenting.
+    Rect dirtyRects[COMPOSE_MAX_DIRTY_RECTS];
+    int dirtyCount = compose_dirty_count;
+    memcpy(dirtyRects, compose_dirty, sizeof(*dirtyRects) * dirtyCount);
+    compose_dirty_count = 0;
+
+    for (int index = 0; index < dirtyCount; index++) {
+        Rect* dirtyRect = &(dirtyRects[index]);
+        compose_rect(dirtyRect, compose_buffer + screenWidth * dirtyRect->uly + dirtyRect->ulx, screenWidth);
+
+        RectPtr rectList = rect_malloc();
+        if (rectList == NULL) {
+            continue;
+        }
+
+        rectList->rect = *dirtyRect;
+        rectList->next = NULL;
+
+        // Mouse cursor is drawn directly to the screen, keep it intact and
+        // redraw it over new contents afterwards.
+        Rect mouseIntersection;
+        if (mouseVisible && rect_inside_bound(dirtyRect, &mouseRect, &mouseIntersection) == 0) {
+            rect_clip_list(&rectList, &mouseRect);
+            mouseDirty = true;
+        }
+
+        while (rectList != NULL) {
+            RectPtr next = rectList->next;
+
+            scr_blit(compose_buffer,
+                screenWidth,
+                rectGetHeight(&scr_size),
+                rectList->rect.ulx,
+                rectList->rect.uly,
+                rectGetWidth(&(rectList->rect)),
+                rectGetHeight(&(rectList->rect)),
+                rectList->rect.ulx,
+                rectList->rect.uly);
+
+            rect_free(rectList);
+            rectList = next;
+        }
+    }
+
+    if (mouseDirty) {
+        mouse_show();
+    }
+}
+
+// CE: Adds `rect` to the list of areas to be composed on the next flush.
+// Overlapping areas are merged so no pixel is composed twice.
+static void compose_add_dirty(const Rect* rect)
+{
+    Rect dirtyRect;
+    if (rect_inside_bound(rect, &scr_size, &dirtyRect) != 0) {
+        return;
+    }
+
+    int index = 0;
+    while (index < compose_dirty_count) {
+        Rect* other = &(compose_dirty[index]);
+        if (dirtyRect.ulx <= other->lrx && other->ulx <= dirtyRect.lrx
+            && dirtyRect.uly <= other->lry && other->uly <= dirtyRect.lry) {
+            rect_min_bound(&dirtyRect, other, &dirtyRect);
+
+            // Grown rect can overlap rects which were checked already.
+            compose_dirty[index] = compose_dirty[compose_dirty_count - 1];
+            compose_dirty_count--;
+            index = 0;
+        } else {
+            index++;
+        }
+    }
+
+    if (compose_dirty_count == COMPOSE_MAX_DIRTY_RECTS) {
+        for (index = 0; index < compose_dirty_count; index++) {
+            rect_min_bound(&dirtyRect, &(compose_dirty[index]), &dirtyRect);
+        }
+        compose_dirty_count = 0;
+    }
+
+    compose_dirty[compose_dirty_count++] = dirtyRect;
+}
+
+// CE: Rebuilds coverage map - index of topmost opaque window for every
+// screen pixel. Needed only when windows are added, removed, moved, shown,
+// hidden or restacked.
+static void compose_build_coverage()
+{
+    int screenWidth = rectGetWidth(&scr_size);
+
+    memset(compose_coverage, COMPOSE_NO_WINDOW, screenWidth * rectGetHeight(&scr_size));
 
     for (int index = 0; index < num_windows; index++) {
-        GNW_win_refresh(window[index], rect, a2);
+        Window* w = window[index];
+        if ((w->flags & WINDOW_HIDDEN) != 0) {
+            continue;
+        }
+
+        if (buffering && (w->flags & WINDOW_TRANSPARENT) != 0) {
+            continue;
+        }
+
+        Rect rect;
+        if (rect_inside_bound(&(w->rect), &scr_size, &rect) != 0) {
+            continue;
+        }
+
+        buf_fill(compose_coverage + screenWidth * rect.uly + rect.ulx,
+            rectGetWidth(&rect),
+            rectGetHeight(&rect),
+            screenWidth,
+            index);
     }
 
-    doing_refresh_all = 0;
+    compose_coverage_valid = true;
+}
 
-    if (a2 == NULL) {
-        if (!mouse_hidden()) {
-            if (mouse_in(rect->ulx, rect->uly, rect->lrx, rect->lry)) {
-                mouse_show();
+// CE: Composes screen contents of `rect` (must be within screen bounds)
+// into `dest`. Runs of pixels owned by the same window are copied at once,
+// transparent windows (when buffering) are blended over their owners.
+static void compose_rect(Rect* rect, unsigned char* dest, int destPitch)
+{
+    if (!compose_coverage_valid) {
+        compose_build_coverage();
+    }
+
+    int screenWidth = rectGetWidth(&scr_size);
+
+    // Let buttons update window buffers in the affected area.
+    for (int index = 1; index < num_windows; index++) {
+        Window* w = window[index];
+        if ((w->flags & WINDOW_HIDDEN) == 0 && w->buttonListHead != NULL) {
+            Rect buttonRect;
+            if (rect_inside_bound(rect, &(w->rect), &buttonRect) == 0) {
+                GNW_button_refresh(w, &buttonRect);
+            }
+        }
+    }
+
+    for (int y = rect->uly; y <= rect->lry; y++) {
+        unsigned char* coverage = compose_coverage + screenWidth * y;
+        unsigned char* destRow = dest + destPitch * (y - rect->uly) - rect->ulx;
+
+        int x = rect->ulx;
+        while (x <= rect->lrx) {
+            int owner = coverage[x];
+            int runStart = x;
+            while (x <= rect->lrx && coverage[x] == owner) {
+                x++;
+            }
+
+            int runWidth = x - runStart;
+
+            Window* w = owner != COMPOSE_NO_WINDOW ? window[owner] : NULL;
+            if (w != NULL && w->id != 0) {
+                memcpy(destRow + runStart,
+                    w->buffer + w->width * (y - w->rect.uly) + runStart - w->rect.ulx,
+                    runWidth);
+            } else {
+                memset(destRow + runStart, bk_color, runWidth);
+            }
+
+            if (buffering) {
+                for (int index = owner != COMPOSE_NO_WINDOW ? owner + 1 : 0; index < num_windows; index++) {
+                    Window* transparent = window[index];
+                    if ((transparent->flags & (WINDOW_HIDDEN | WINDOW_TRANSPARENT)) != WINDOW_TRANSPARENT) {
+                        continue;
+                    }
+
+                    if (y < transparent->rect.uly || y > transparent->rect.lry) {
+                        continue;
+                    }
+
+                    int left = std::max(runStart, transparent->rect.ulx);
+                    int right = std::min(x - 1, transparent->rect.lrx);
+                    if (left > right) {
+                        continue;
+                    }
+
+                    transparent->blitProc(transparent->buffer + transparent->width * (y - transparent->rect.uly) + left - transparent->rect.ulx,
+                        right - left + 1,
+                        1,
+                        transparent->width,
+                        destRow + left,
+                        destPitch);
+                }
             }
         }
     }
@@ -12,6 +12,7 @@
 #include "plib/gnw/grbuf.h"
 #include "plib/gnw/intrface.h"
 #include "plib/gnw/memory.h"
+#include "plib/gnw/profile.h"
 #include "plib/gnw/svga.h"
 #include "plib/gnw/text.h"
 #include "plib/gnw/touch.h"
@@ -197,6 +198,8 @@ void GNW_input_exit()
 // 0x4B33C8
 int get_input()
 {
+    PROFILE_ZONE("get_input");
+
     int v3;
 
     GNW95_process_message();
@@ -266,6 +269,19 @@ void GNW_add_input_buffer(int a1)
         return;
     }
 
+#ifdef FALLOUT_PROFILE
+    // CE: Frame profiler overlay and statistics export.
+    if (a1 == KEY_ALT_F) {
+        profile_toggle_overlay();
+        return;
+    }
+
+    if (a1 == KEY_ALT_O) {
+        profile_dump();
+        return;
+    }
+#endif
+
     if (input_put == input_get) {
         return;
     }
@@ -331,6 +347,8 @@ void GNW_do_bk_process()
         return;
     }
 
+    PROFILE_ZONE("bk_process");
+
     bk_process_time = get_time();
 
     FuncPtr curr = bk_list;
@@ -485,6 +503,10 @@ void dump_screen()
         return;
     }
 
+    // CE: Present pending window updates to the real screen before
+    // redirecting blits into the dump buffer.
+    win_flush_dirty();
+
     old_scr_blit = scr_blit;
     scr_blit = buf_blit;
 
@@ -518,8 +540,6 @@ int default_screendump(int width, int height, unsigned char* data, unsigned char
     char fileName[16];
     FILE* stream;
     int index;
-    unsigned int intValue;
-    unsigned short shortValue;
 
     for (index = 0; index < 100000; index++) {
         snprintf(fileName, sizeof(fileName), "scr%.5d.bmp", index);
@@ -536,6 +556,16 @@ int default_screendump(int width, int height, unsigned char* data, unsigned char
         return -1;
     }
 
+    return save_bmp(fileName, width, height, data, palette);
+}
+
+// Saves 8-bit image as BMP file. `palette` is 6-bit VGA palette.
+int save_bmp(const char* fileName, int width, int height, unsigned char* data, unsigned char* palette)
+{
+    FILE* stream;
+    unsigned int intValue;
+    unsigned short shortValue;
+
     stream = compat_fopen(fileName, "wb");
     if (stream == NULL) {
         return -1;
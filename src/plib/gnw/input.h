@@ -29,6 +29,7 @@ void disable_bk();
 void register_pause(int new_pause_key, PauseWinFunc* new_pause_win_func);
 void dump_screen();
 int default_screendump(int width, int height, unsigned char* data, unsigned char* palette);
+int save_bmp(const char* fileName, int width, int height, unsigned char* data, unsigned char* palette);
 void register_screendump(int new_screendump_key, ScreenDumpFunc* new_screendump_func);
 unsigned int get_time();
 void pause_for_tocks(unsigned int ms);
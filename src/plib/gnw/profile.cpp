@@ -0,0 +1,391 @@
+#include "plib/gnw/profile.h"
+
+#ifdef FALLOUT_PROFILE
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <SDL.h>
+
+#include "platform_compat.h"
+#include "plib/color/color.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/gnw.h"
+#include "plib/gnw/input.h"
+#include "plib/gnw/text.h"
+
+namespace fallout {
+
+#define PROFILE_STACK_SIZE 32
+#define PROFILE_OVERLAY_WIDTH 300
+#define PROFILE_OVERLAY_FRAMES 60
+#define PROFILE_OVERLAY_UPDATE_DELAY 500
+
+typedef struct ProfileZoneInfo {
+    const char* name;
+
+    // Nesting depth when zone was entered first time (for presentation).
+    int depth;
+
+    // Number of currently open scopes of this zone, only outermost scope
+    // accumulates time to avoid counting recursive calls twice.
+    int active;
+} ProfileZoneInfo;
+
+typedef struct ProfileStackEntry {
+    int zone;
+    Uint64 start;
+} ProfileStackEntry;
+
+static void profile_overlay_update();
+static float profile_us_to_ms(unsigned int value);
+static void profile_percentiles(unsigned int* samples, int count, float* avg, float* p50, float* p90, float* p99, float* max);
+
+static ProfileZoneInfo profile_zones[PROFILE_ZONE_MAX_COUNT];
+static int profile_zone_count = 0;
+
+static ProfileStackEntry profile_stack[PROFILE_STACK_SIZE];
+static int profile_stack_size = 0;
+
+// Number of scopes entered while the stack was full. They are not tracked,
+// and their leaves (which always come first) are skipped.
+static int profile_stack_overflow = 0;
+
+// Time spent in zones during current frame (in microseconds).
+static unsigned int profile_current[PROFILE_ZONE_MAX_COUNT];
+
+// Ring buffer of completed frames (in microseconds).
+static unsigned int profile_samples[PROFILE_FRAME_COUNT][PROFILE_ZONE_MAX_COUNT];
+static unsigned int profile_frame_times[PROFILE_FRAME_COUNT];
+
+// Time spent in zones since start (in performance counter ticks), not
+// rounded per scope, so short zones entered many times add up correctly.
+static Uint64 profile_totals[PROFILE_ZONE_MAX_COUNT];
+
+// Index of the next frame to write in the ring buffer.
+static int profile_frame_index = 0;
+
+// Number of valid frames in the ring buffer.
+static int profile_frame_count = 0;
+
+static Uint64 profile_frequency = 0;
+static Uint64 profile_last_frame = 0;
+
+static int profile_overlay_win = -1;
+static int profile_overlay_zone_count = 0;
+static unsigned int profile_overlay_last_update = 0;
+
+// Returns zone id for the given name, registering new zone if needed.
+//
+// NOTE: `name` is expected to be a string literal, it's not copied.
+int profile_zone_register(const char* name)
+{
+    for (int zone = 0; zone < profile_zone_count; zone++) {
+        if (strcmp(profile_zones[zone].name, name) == 0) {
+            return zone;
+        }
+    }
+
+    if (profile_zone_count == PROFILE_ZONE_MAX_COUNT) {
+        debug_printf("profile: too many zones, \"%s\" is not tracked\n", name);
+        return -1;
+    }
+
+    ProfileZoneInfo* zoneInfo = &(profile_zones[profile_zone_count]);
+    zoneInfo->name = name;
+    zoneInfo->depth = -1;
+    zoneInfo->active = 0;
+
+    return profile_zone_count++;
+}
+
+void profile_zone_enter(int zone)
+{
+    if (zone == -1) {
+        return;
+    }
+
+    if (profile_stack_size == PROFILE_STACK_SIZE) {
+        profile_stack_overflow++;
+        return;
+    }
+
+    ProfileZoneInfo* zoneInfo = &(profile_zones[zone]);
+    if (zoneInfo->depth == -1) {
+        zoneInfo->depth = profile_stack_size;
+    }
+
+    zoneInfo->active++;
+
+    ProfileStackEntry* entry = &(profile_stack[profile_stack_size++]);
+    entry->zone = zone;
+    entry->start = SDL_GetPerformanceCounter();
+}
+
+void profile_zone_leave(int zone)
+{
+    if (zone == -1) {
+        return;
+    }
+
+    // Scopes always unwind in order, so the innermost scopes are the ones
+    // which did not fit into the stack. Checking zone id instead is not
+    // enough, recursive zones would close their outer scope too early.
+    if (profile_stack_overflow != 0) {
+        profile_stack_overflow--;
+        return;
+    }
+
+    if (profile_stack_size == 0) {
+        return;
+    }
+
+    ProfileStackEntry* entry = &(profile_stack[--profile_stack_size]);
+    ProfileZoneInfo* zoneInfo = &(profile_zones[zone]);
+
+    zoneInfo->active--;
+    if (zoneInfo->active == 0) {
+        if (profile_frequency == 0) {
+            profile_frequency = SDL_GetPerformanceFrequency();
+        }
+
+        Uint64 elapsed = SDL_GetPerformanceCounter() - entry->start;
+        profile_current[zone] += (unsigned int)(elapsed * 1000000 / profile_frequency);
+        profile_totals[zone] += elapsed;
+    }
+}
+
+// Returns total time spent in zone since start (in microseconds).
+//
+// Unlike per-frame samples it's not affected by frame boundaries, so it can
+// be used to measure arbitrary spans (see `cbench_turn_begin`).
+unsigned long long profile_zone_total(int zone)
+{
+    if (zone == -1) {
+        return 0;
+    }
+
+    if (profile_frequency == 0) {
+        profile_frequency = SDL_GetPerformanceFrequency();
+    }
+
+    Uint64 total = profile_totals[zone];
+    return total / profile_frequency * 1000000 + total % profile_frequency * 1000000 / profile_frequency;
+}
+
+// Closes current frame and moves accumulated zone times into ring buffer.
+//
+// Called once per presented frame.
+void profile_frame_end()
+{
+    if (profile_frequency == 0) {
+        profile_frequency = SDL_GetPerformanceFrequency();
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (profile_last_frame == 0) {
+        profile_last_frame = now;
+    }
+
+    profile_frame_times[profile_frame_index] = (unsigned int)((now - profile_last_frame) * 1000000 / profile_frequency);
+    memcpy(profile_samples[profile_frame_index], profile_current, sizeof(profile_current));
+    memset(profile_current, 0, sizeof(profile_current));
+
+    profile_frame_index = (profile_frame_index + 1) % PROFILE_FRAME_COUNT;
+    if (profile_frame_count < PROFILE_FRAME_COUNT) {
+        profile_frame_count++;
+    }
+
+    profile_last_frame = now;
+
+    if (profile_overlay_win != -1) {
+        profile_overlay_update();
+    }
+}
+
+void profile_toggle_overlay()
+{
+    if (profile_overlay_win != -1) {
+        win_delete(profile_overlay_win);
+        profile_overlay_win = -1;
+        return;
+    }
+
+    profile_overlay_zone_count = profile_zone_count;
+    profile_overlay_last_update = 0;
+
+    int height = (profile_overlay_zone_count + 2) * text_height() + 8;
+    profile_overlay_win = win_add(0, 0, PROFILE_OVERLAY_WIDTH, height, colorTable[0], WINDOW_MOVE_ON_TOP);
+    if (profile_overlay_win == -1) {
+        return;
+    }
+
+    profile_overlay_update();
+}
+
+// Redraws overlay with average and maximum zone times over the last
+// `PROFILE_OVERLAY_FRAMES` frames.
+static void profile_overlay_update()
+{
+    if (elapsed_time(profile_overlay_last_update) < PROFILE_OVERLAY_UPDATE_DELAY) {
+        return;
+    }
+
+    // Zones registered after overlay was created need taller window.
+    if (profile_overlay_zone_count != profile_zone_count) {
+        win_delete(profile_overlay_win);
+        profile_overlay_win = -1;
+        profile_toggle_overlay();
+        return;
+    }
+
+    profile_overlay_last_update = get_time();
+
+    int frames = std::min(profile_frame_count, PROFILE_OVERLAY_FRAMES);
+    if (frames == 0) {
+        return;
+    }
+
+    int color = colorTable[992];
+    int lineHeight = text_height();
+    int width = PROFILE_OVERLAY_WIDTH - 8;
+    int y = 4;
+    char line[80];
+
+    unsigned int frameSum = 0;
+    unsigned int frameMax = 0;
+    for (int index = 0; index < frames; index++) {
+        unsigned int value = profile_frame_times[(profile_frame_index - 1 - index + PROFILE_FRAME_COUNT) % PROFILE_FRAME_COUNT];
+        frameSum += value;
+        frameMax = std::max(frameMax, value);
+    }
+
+    float frameAvg = profile_us_to_ms(frameSum) / frames;
+    snprintf(line, sizeof(line), "frame %6.2f ms (max %6.2f) %5.1f fps", frameAvg, profile_us_to_ms(frameMax), frameAvg > 0.0f ? 1000.0f / frameAvg : 0.0f);
+    win_print(profile_overlay_win, line, width, 4, y, color);
+    y += lineHeight;
+
+    win_print(profile_overlay_win, "zone                     avg       max", width, 4, y, color);
+    y += lineHeight;
+
+    for (int zone = 0; zone < profile_zone_count; zone++) {
+        unsigned int sum = 0;
+        unsigned int max = 0;
+        for (int index = 0; index < frames; index++) {
+            unsigned int value = profile_samples[(profile_frame_index - 1 - index + PROFILE_FRAME_COUNT) % PROFILE_FRAME_COUNT][zone];
+            sum += value;
+            max = std::max(max, value);
+        }
+
+        int depth = std::max(profile_zones[zone].depth, 0);
+        snprintf(line, sizeof(line), "%*s%-*.*s %6.2f ms %6.2f",
+            depth * 2,
+            "",
+            22 - depth * 2,
+            22 - depth * 2,
+            profile_zones[zone].name,
+            profile_us_to_ms(sum) / frames,
+            profile_us_to_ms(max));
+        win_print(profile_overlay_win, line, width, 4, y, color);
+        y += lineHeight;
+    }
+
+    win_draw(profile_overlay_win);
+}
+
+// Writes per-zone frame time statistics over the whole ring buffer into the
+// next available `prfNNNNN.csv`.
+int profile_dump()
+{
+    char fileName[16];
+    FILE* stream;
+    int index;
+
+    if (profile_frame_count == 0) {
+        return -1;
+    }
+
+    for (index = 0; index < 100000; index++) {
+        snprintf(fileName, sizeof(fileName), "prf%.5d.csv", index);
+
+        stream = compat_fopen(fileName, "rb");
+        if (stream == NULL) {
+            break;
+        }
+
+        fclose(stream);
+    }
+
+    if (index == 100000) {
+        return -1;
+    }
+
+    stream = compat_fopen(fileName, "wt");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    unsigned int samples[PROFILE_FRAME_COUNT];
+    float avg;
+    float p50;
+    float p90;
+    float p99;
+    float max;
+
+    fprintf(stream, "zone,depth,frames,avg_ms,p50_ms,p90_ms,p99_ms,max_ms\n");
+
+    memcpy(samples, profile_frame_times, sizeof(*samples) * profile_frame_count);
+    profile_percentiles(samples, profile_frame_count, &avg, &p50, &p90, &p99, &max);
+    fprintf(stream, "frame,0,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", profile_frame_count, avg, p50, p90, p99, max);
+
+    for (int zone = 0; zone < profile_zone_count; zone++) {
+        for (int frame = 0; frame < profile_frame_count; frame++) {
+            samples[frame] = profile_samples[frame][zone];
+        }
+
+        profile_percentiles(samples, profile_frame_count, &avg, &p50, &p90, &p99, &max);
+        fprintf(stream, "%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+            profile_zones[zone].name,
+            std::max(profile_zones[zone].depth, 0) + 1,
+            profile_frame_count,
+            avg,
+            p50,
+            p90,
+            p99,
+            max);
+    }
+
+    fclose(stream);
+
+    debug_printf("profile: %d frames saved to %s\n", profile_frame_count, fileName);
+
+    return 0;
+}
+
+static float profile_us_to_ms(unsigned int value)
+{
+    return value / 1000.0f;
+}
+
+// NOTE: Sorts `samples` in place.
+static void profile_percentiles(unsigned int* samples, int count, float* avg, float* p50, float* p90, float* p99, float* max)
+{
+    std::sort(samples, samples + count);
+
+    unsigned long long sum = 0;
+    for (int index = 0; index < count; index++) {
+        sum += samples[index];
+    }
+
+    *avg = (float)(sum / 1000.0 / count);
+    *p50 = profile_us_to_ms(samples[(count - 1) * 50 / 100]);
+    *p90 = profile_us_to_ms(samples[(count - 1) * 90 / 100]);
+    *p99 = profile_us_to_ms(samples[(count - 1) * 99 / 100]);
+    *max = profile_us_to_ms(samples[count - 1]);
+}
+
+} // namespace fallout
+
+#endif /* FALLOUT_PROFILE */
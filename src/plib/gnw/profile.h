@@ -0,0 +1,61 @@
+#ifndef FALLOUT_PLIB_GNW_PROFILE_H_
+#define FALLOUT_PLIB_GNW_PROFILE_H_
+
+namespace fallout {
+
+// CE: Lightweight frame profiler. Enabled with `FALLOUT_PROFILE` define
+// (`make PROFILE=y`), otherwise all instrumentation compiles to nothing.
+//
+// Zones are named scopes (`PROFILE_ZONE("name")`) which can nest. Time spent
+// in every zone is accumulated during the frame and stored in a ring buffer
+// of the last `PROFILE_FRAME_COUNT` frames when the frame is presented.
+
+#ifdef FALLOUT_PROFILE
+
+#define PROFILE_FRAME_COUNT 256
+#define PROFILE_ZONE_MAX_COUNT 32
+
+int profile_zone_register(const char* name);
+void profile_zone_enter(int zone);
+void profile_zone_leave(int zone);
+void profile_frame_end();
+void profile_toggle_overlay();
+int profile_dump();
+unsigned long long profile_zone_total(int zone);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(int zone)
+        : _zone(zone)
+    {
+        profile_zone_enter(_zone);
+    }
+
+    ~ProfileScope()
+    {
+        profile_zone_leave(_zone);
+    }
+
+private:
+    int _zone;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_ZONE(name)                                                                   \
+    static int PROFILE_CONCAT(profile_zone_, __LINE__) = profile_zone_register(name);        \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_zone_, __LINE__))
+
+#define PROFILE_FRAME_END() profile_frame_end()
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME_END()
+
+#endif
+
+} // namespace fallout
+
+#endif /* FALLOUT_PLIB_GNW_PROFILE_H_ */
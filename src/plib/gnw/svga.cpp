@@ -1,12 +1,42 @@
 #include "plib/gnw/svga.h"
 
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "plib/gnw/debug.h"
 #include "plib/gnw/gnw.h"
 #include "plib/gnw/grbuf.h"
+#include "plib/gnw/input.h"
+#include "plib/gnw/memory.h"
 #include "plib/gnw/mouse.h"
+#include "plib/gnw/profile.h"
 #include "plib/gnw/winmain.h"
+
+#ifdef NXDK
 #include <hal/video.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace fallout {
 
+static void svga_present();
+static void svga_upscale(unsigned char* pixels, int pitch);
+static void svga_upscale_rect(unsigned char* pixels, int pitch, const Rect* rect);
+static void svga_upscale_cycle(unsigned char* pixels, int pitch);
+static void svga_convert_span(unsigned char* pixels, int pitch, int y, int start, int end);
+static void svga_update_extend(int left, int top, int right, int bottom);
+static void svga_set_palette_color(int index, Uint32 color);
+static void svga_cycle_scan(int y, int start, int end);
+static void svga_expand_row(const unsigned char* src, int width, Uint32* dest, int repeat);
+static void svga_scale2x_row(const unsigned char* above, const unsigned char* row, const unsigned char* below, int width, unsigned char* dest0, unsigned char* dest1, int start, int end);
+static void svga_scale2x_span(const unsigned char* above, const unsigned char* row, const unsigned char* below, int width, unsigned char* dest0, unsigned char* dest1, int start, int end);
+static void frame_capture(SDL_Surface* surface);
+
 
 // screen rect
 Rect scr_size;
@@ -20,6 +50,66 @@ SDL_Renderer* gSdlRenderer = NULL;
 SDL_Texture* gSdlTexture = NULL;
 //SDL_Surface* gSdlTextureSurface = NULL;
 
+// CE: Null video backend - only `gSdlSurface` is allocated.
+static bool svga_headless = false;
+
+// CE: Frame capture options (see `VideoOptions`).
+static bool svga_frame_hash = false;
+static bool svga_frame_dump = false;
+
+// CE: Number of frames presented so far.
+static unsigned int svga_frame_count = 0;
+
+// CE: Integer upscaling done while converting indexed frame to the
+// texture (see `svga_upscale`).
+static int svga_scale = 1;
+static int svga_scale_filter = SCALE_FILTER_NEAREST;
+
+// CE: Current palette in texture format.
+static Uint32 svga_palette[256];
+
+// CE: Scale2x intermediate output (two indexed rows).
+static unsigned char* svga_scale_rows = NULL;
+
+// CE: Converted frame in texture format (and size). Locked texture contents
+// are undefined, so previous frame is kept here instead. Only screen area
+// written since the last present and pixels affected by palette changes are
+// converted again, then area covering them is uploaded to the texture.
+// Without this buffer every present converts the whole frame.
+static Uint32* svga_frame = NULL;
+static int svga_frame_pitch = 0;
+
+// CE: Area of `svga_frame` (in texture pixels) converted during the current
+// present.
+static bool svga_update_valid = false;
+static Rect svga_update_rect;
+
+// CE: Partial refresh state.
+//
+// Palette changes limited to color cycling range (see `cycle.cpp`) only
+// re-convert pixels using these indices, any other palette change converts
+// the whole frame.
+#define SVGA_CYCLE_FIRST 229
+#define SVGA_CYCLE_LAST 254
+
+static bool svga_full_dirty = true;
+static bool svga_cycle_dirty = false;
+static bool svga_rect_dirty = false;
+static Rect svga_dirty_rect;
+
+// CE: Per-row span (`[min, max]`, inclusive) of pixels using color cycling
+// indices as of the last conversion, empty when `min > max`. Spans are exact
+// after full frame conversion or when whole row is redrawn, partial redraws
+// only grow them.
+static short* svga_cycle_min = NULL;
+static short* svga_cycle_max = NULL;
+
+// CE: Conversion statistics, reported on exit.
+static unsigned int svga_full_count = 0;
+static unsigned int svga_partial_count = 0;
+static unsigned int svga_cycle_count = 0;
+static unsigned long long svga_converted_pixels = 0;
+
 // TODO: Remove once migration to update-render cycle is completed.
 FpsLimiter sharedFpsLimiter;
 
@@ -32,6 +122,8 @@ void GNW95_SetPaletteEntries(unsigned char* palette, int start, int count)
             colors[i].g = palette[i * 3 + 1] << 2;
             colors[i].b = palette[i * 3 + 2] << 2;
             colors[i].a = 255;
+
+            svga_set_palette_color(start + i, 0xFF000000 | (colors[i].r << 16) | (colors[i].g << 8) | colors[i].b);
         }
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, start, count);
     }
@@ -46,11 +138,56 @@ void GNW95_SetPalette(unsigned char* palette)
             colors[i].g = palette[i * 3 + 1] << 2;
             colors[i].b = palette[i * 3 + 2] << 2;
             colors[i].a = 255;
+
+            svga_set_palette_color(i, 0xFF000000 | (colors[i].r << 16) | (colors[i].g << 8) | colors[i].b);
         }
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, 0, 256);
     }
 }
 
+// CE: Updates texture palette and records what part of the frame must be
+// converted again.
+static void svga_set_palette_color(int index, Uint32 color)
+{
+    if (svga_palette[index] == color) {
+        return;
+    }
+
+    svga_palette[index] = color;
+
+    if (index >= SVGA_CYCLE_FIRST && index <= SVGA_CYCLE_LAST) {
+        svga_cycle_dirty = true;
+    } else {
+        svga_full_dirty = true;
+    }
+}
+
+// CE: Marks screen area written directly to `gSdlSurface` (bypassing
+// `scr_blit`) so it's converted on the next present.
+void svga_mark_dirty(int x, int y, int width, int height)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    Rect rect;
+    rect.ulx = x;
+    rect.uly = y;
+    rect.lrx = x + width - 1;
+    rect.lry = y + height - 1;
+
+    if (rect_inside_bound(&rect, &scr_size, &rect) != 0) {
+        return;
+    }
+
+    if (svga_rect_dirty) {
+        rect_min_bound(&svga_dirty_rect, &rect, &svga_dirty_rect);
+    } else {
+        svga_dirty_rect = rect;
+        svga_rect_dirty = true;
+    }
+}
+
 
 // 0x4CB850
 void GNW95_ShowRect(unsigned char* src, unsigned int srcPitch, unsigned int a3, unsigned int srcX, unsigned int srcY, unsigned int srcWidth, unsigned int srcHeight, unsigned int destX, unsigned int destY)
@@ -67,6 +204,8 @@ void GNW95_ShowRect(unsigned char* src, unsigned int srcPitch, unsigned int a3,
     destRect.x = destX;
     destRect.y = destY;
     //SDL_BlitSurface(gSdlSurface, &srcRect, gSdlTextureSurface, &destRect);
+
+    svga_mark_dirty(destX, destY, srcWidth, srcHeight);
 }
 bool svga_init(VideoOptions* video_options)
 {
@@ -75,9 +214,44 @@ bool svga_init(VideoOptions* video_options)
     int scaled_width = width * video_options->scale;
     int scaled_height = height * video_options->scale;
 
+    svga_headless = video_options->headless;
+    svga_frame_hash = video_options->frameHash;
+    svga_frame_dump = video_options->frameDump;
+    svga_frame_count = 0;
+
+    svga_scale = std::max(video_options->scale, 1);
+    svga_scale_filter = video_options->scaleFilter;
+
+    svga_full_dirty = true;
+    svga_cycle_dirty = false;
+    svga_rect_dirty = false;
+
+    if (svga_headless) {
+        // CE: Null backend - game renders into the 8-bit surface as usual,
+        // `renderPresent` only captures frames (if requested).
+        gSdlSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 8, SDL_PIXELFORMAT_INDEX8);
+        if (!gSdlSurface) {
+            return false;
+        }
+
+        scr_size.ulx = 0;
+        scr_size.uly = 0;
+        scr_size.lrx = width - 1;
+        scr_size.lry = height - 1;
+
+        mouse_blit_trans = nullptr;
+        scr_blit = GNW95_ShowRect;
+        mouse_blit = GNW95_ShowRect;
+
+        debug_printf("svga_init: null video backend (%dx%d)\n", width, height);
+        return true;
+    }
+
+#ifdef NXDK
     // Step 0: Set Xbox framebuffer video mode
     XVideoSetMode(scaled_width, scaled_height, 32, REFRESH_DEFAULT);
     // DbgPrint("svga_init: XVideoSetMode done (%dx%d)\n", scaled_width, scaled_height);
+#endif
 
     // [SDL_Init is now done in game_init()]
     // Do NOT call SDL_Init here.
@@ -120,11 +294,14 @@ bool svga_init(VideoOptions* video_options)
     }
 
     // Step 4: Create streaming texture (ARGB8888 format for final blit)
+    //
+    // CE: Texture has final (scaled) size, upscaling is done in
+    // `svga_upscale` so renderer only copies it.
     gSdlTexture = SDL_CreateTexture(gSdlRenderer,
                                     SDL_PIXELFORMAT_ARGB8888,
                                     SDL_TEXTUREACCESS_STREAMING,
-                                    width,
-                                    height);
+                                    scaled_width,
+                                    scaled_height);
     if (!gSdlTexture) {
         // DbgPrint("svga_init: SDL_CreateTexture failed: %s\n", SDL_GetError());
         SDL_FreeSurface(gSdlSurface);
@@ -136,6 +313,28 @@ bool svga_init(VideoOptions* video_options)
         return false;
     }
 
+    svga_frame_pitch = scaled_width * sizeof(*svga_frame);
+    svga_frame = (Uint32*)mem_malloc(svga_frame_pitch * scaled_height);
+    if (svga_frame == NULL) {
+        // Not fatal - every present converts the whole frame.
+        debug_printf("svga_init: no memory for frame buffer, partial updates disabled\n");
+    }
+
+    svga_cycle_min = (short*)mem_malloc(sizeof(*svga_cycle_min) * height);
+    svga_cycle_max = (short*)mem_malloc(sizeof(*svga_cycle_max) * height);
+    if (svga_cycle_min == NULL || svga_cycle_max == NULL) {
+        // Not fatal - every palette change converts the whole frame.
+        if (svga_cycle_min != NULL) {
+            mem_free(svga_cycle_min);
+            svga_cycle_min = NULL;
+        }
+
+        if (svga_cycle_max != NULL) {
+            mem_free(svga_cycle_max);
+            svga_cycle_max = NULL;
+        }
+    }
+
     // Step 5: Set screen dimensions
     scr_size.ulx = 0;
     scr_size.uly = 0;
@@ -159,6 +358,37 @@ void svga_exit()
         gSdlTexture = NULL;
     }
 
+    if (svga_scale_rows != NULL) {
+        mem_free(svga_scale_rows);
+        svga_scale_rows = NULL;
+    }
+
+    if (svga_frame != NULL) {
+        mem_free(svga_frame);
+        svga_frame = NULL;
+    }
+
+    if (svga_cycle_min != NULL) {
+        mem_free(svga_cycle_min);
+        svga_cycle_min = NULL;
+    }
+
+    if (svga_cycle_max != NULL) {
+        mem_free(svga_cycle_max);
+        svga_cycle_max = NULL;
+    }
+
+    if (svga_full_count + svga_partial_count + svga_cycle_count != 0 && gSdlSurface != NULL) {
+        unsigned long long framePixels = (unsigned long long)gSdlSurface->w * gSdlSurface->h;
+        unsigned long long totalPixels = framePixels * (svga_full_count + svga_partial_count + svga_cycle_count);
+        debug_printf("svga: %u full, %u partial, %u cycle-only conversions, %llu pixels converted (%.1f%% of full frames)\n",
+            svga_full_count,
+            svga_partial_count,
+            svga_cycle_count,
+            svga_converted_pixels,
+            svga_converted_pixels * 100.0 / totalPixels);
+    }
+
     if (gSdlRenderer) {
         SDL_DestroyRenderer(gSdlRenderer);
         gSdlRenderer = NULL;
@@ -196,17 +426,436 @@ void handleWindowSizeChanged()
     //createRenderer(screenGetWidth(), screenGetHeight());
 }
 void renderPresent() {
+    svga_present();
+    PROFILE_FRAME_END();
+}
+
+static void svga_present()
+{
+    PROFILE_ZONE("present");
+
+    // CE: Compose windows refreshed during this frame.
+    win_flush_dirty();
+
+    if (gSdlSurface != NULL && (svga_frame_hash || svga_frame_dump)) {
+        frame_capture(gSdlSurface);
+    }
+
+    svga_frame_count++;
+
     if (!gSdlSurface || !gSdlTexture || !gSdlRenderer) return;
 
-    SDL_Surface* converted = SDL_ConvertSurfaceFormat(gSdlSurface, SDL_PIXELFORMAT_ARGB8888, 0);
-    SDL_UpdateTexture(gSdlTexture, NULL, converted->pixels, converted->pitch);
-    SDL_FreeSurface(converted);
+    // CE: Expand (and upscale) changed parts of indexed frame into frame
+    // buffer and upload them to the texture.
+    if (svga_full_dirty || svga_rect_dirty || svga_cycle_dirty) {
+        void* pixels = svga_frame;
+        int pitch = svga_frame_pitch;
+        if (svga_frame == NULL) {
+            // Every pixel of locked texture must be written.
+            if (SDL_LockTexture(gSdlTexture, NULL, &pixels, &pitch) != 0) {
+                return;
+            }
+
+            svga_full_dirty = true;
+        }
+
+        svga_update_valid = false;
+
+        if (svga_full_dirty || (svga_cycle_dirty && svga_cycle_min == NULL)) {
+            svga_upscale((unsigned char*)pixels, pitch);
+            svga_full_count++;
+        } else {
+            if (svga_rect_dirty) {
+                svga_upscale_rect((unsigned char*)pixels, pitch, &svga_dirty_rect);
+                svga_partial_count++;
+            }
+
+            if (svga_cycle_dirty) {
+                svga_upscale_cycle((unsigned char*)pixels, pitch);
+                if (!svga_rect_dirty) {
+                    svga_cycle_count++;
+                }
+            }
+        }
+
+        if (svga_frame == NULL) {
+            SDL_UnlockTexture(gSdlTexture);
+        } else if (svga_update_valid) {
+            SDL_Rect rect;
+            rect.x = svga_update_rect.ulx;
+            rect.y = svga_update_rect.uly;
+            rect.w = rectGetWidth(&svga_update_rect);
+            rect.h = rectGetHeight(&svga_update_rect);
+            SDL_UpdateTexture(gSdlTexture,
+                &rect,
+                (unsigned char*)svga_frame + svga_frame_pitch * rect.y + rect.x * sizeof(*svga_frame),
+                svga_frame_pitch);
+        }
+
+        svga_full_dirty = false;
+        svga_rect_dirty = false;
+        svga_cycle_dirty = false;
+    }
 
     SDL_RenderClear(gSdlRenderer);
     SDL_RenderCopy(gSdlRenderer, gSdlTexture, NULL, NULL);
     SDL_RenderPresent(gSdlRenderer);
 }
 
+// CE: Converts indexed frame into texture pixels, scaling it by integer
+// factor.
+static void svga_upscale(unsigned char* pixels, int pitch)
+{
+    PROFILE_ZONE("upscale");
+
+    int width = gSdlSurface->w;
+    int height = gSdlSurface->h;
+
+    for (int y = 0; y < height; y++) {
+        svga_convert_span(pixels, pitch, y, 0, width);
+
+        if (svga_cycle_min != NULL) {
+            svga_cycle_min[y] = width;
+            svga_cycle_max[y] = -1;
+            svga_cycle_scan(y, 0, width);
+        }
+    }
+}
+
+// CE: Converts part of indexed frame written since the last present.
+static void svga_upscale_rect(unsigned char* pixels, int pitch, const Rect* rect)
+{
+    PROFILE_ZONE("upscale");
+
+    int width = gSdlSurface->w;
+    int height = gSdlSurface->h;
+
+    // Scale2x output depends on neighbouring pixels.
+    int border = svga_scale == 2 && svga_scale_filter == SCALE_FILTER_SCALE2X ? 1 : 0;
+    int left = std::max(rect->ulx - border, 0);
+    int top = std::max(rect->uly - border, 0);
+    int right = std::min(rect->lrx + border, width - 1);
+    int bottom = std::min(rect->lry + border, height - 1);
+
+    for (int y = top; y <= bottom; y++) {
+        svga_convert_span(pixels, pitch, y, left, right + 1);
+    }
+
+    if (svga_cycle_min != NULL) {
+        for (int y = rect->uly; y <= rect->lry; y++) {
+            // Whole row redrawn (which is typical for map scrolling) - span is
+            // rebuilt, otherwise it's extended with new pixels.
+            if (rect->ulx == 0 && rect->lrx == width - 1) {
+                svga_cycle_min[y] = width;
+                svga_cycle_max[y] = -1;
+            }
+            svga_cycle_scan(y, rect->ulx, rect->lrx + 1);
+        }
+    }
+}
+
+// CE: Converts pixels using color cycling indices after palette rotation.
+static void svga_upscale_cycle(unsigned char* pixels, int pitch)
+{
+    PROFILE_ZONE("upscale");
+
+    int width = gSdlSurface->w;
+    int height = gSdlSurface->h;
+
+    if (svga_scale == 2 && svga_scale_filter == SCALE_FILTER_SCALE2X) {
+        // Scale2x output of a pixel depends on its four neighbours, so spans
+        // of adjacent rows are merged and widened by one pixel.
+        for (int y = 0; y < height; y++) {
+            int start = width;
+            int end = -1;
+            for (int row = std::max(y - 1, 0); row <= std::min(y + 1, height - 1); row++) {
+                start = std::min(start, (int)svga_cycle_min[row]);
+                end = std::max(end, (int)svga_cycle_max[row]);
+            }
+
+            if (start <= end) {
+                svga_convert_span(pixels, pitch, y, std::max(start - 1, 0), std::min(end + 2, width));
+            }
+        }
+        return;
+    }
+
+    for (int y = 0; y < height; y++) {
+        if (svga_cycle_min[y] <= svga_cycle_max[y]) {
+            svga_convert_span(pixels, pitch, y, svga_cycle_min[y], svga_cycle_max[y] + 1);
+        }
+    }
+}
+
+// CE: Converts pixels `[start, end)` of row `y` into texture pixels, scaling
+// them by integer factor. Scale2x works on palette indices (so equality tests
+// are exact and four times cheaper than on colors), its output is expanded
+// afterwards.
+static void svga_convert_span(unsigned char* pixels, int pitch, int y, int start, int end)
+{
+    int width = gSdlSurface->w;
+    int height = gSdlSurface->h;
+    int srcPitch = gSdlSurface->pitch;
+    unsigned char* row = (unsigned char*)gSdlSurface->pixels + srcPitch * y;
+    int length = end - start;
+
+    svga_converted_pixels += length;
+
+    svga_update_extend(start * svga_scale, y * svga_scale, end * svga_scale - 1, y * svga_scale + svga_scale - 1);
+
+    if (svga_scale == 2 && svga_scale_filter == SCALE_FILTER_SCALE2X) {
+        if (svga_scale_rows == NULL) {
+            svga_scale_rows = (unsigned char*)mem_malloc(width * 2 * 2);
+        }
+
+        if (svga_scale_rows != NULL) {
+            unsigned char* dest0 = svga_scale_rows;
+            unsigned char* dest1 = svga_scale_rows + width * 2;
+            unsigned char* above = y > 0 ? row - srcPitch : row;
+            unsigned char* below = y < height - 1 ? row + srcPitch : row;
+
+            svga_scale2x_row(above, row, below, width, dest0, dest1, start, end);
+
+            unsigned char* dest = pixels + pitch * (y * 2) + start * 2 * sizeof(Uint32);
+            svga_expand_row(dest0 + start * 2, length * 2, (Uint32*)dest, 1);
+            svga_expand_row(dest1 + start * 2, length * 2, (Uint32*)(dest + pitch), 1);
+            return;
+        }
+    }
+
+    // Integer nearest neighbour - expand each row once, duplicate it for
+    // remaining output rows.
+    unsigned char* dest = pixels + pitch * (y * svga_scale) + start * svga_scale * sizeof(Uint32);
+    svga_expand_row(row + start, length, (Uint32*)dest, svga_scale);
+
+    for (int copy = 1; copy < svga_scale; copy++) {
+        memcpy(dest + pitch * copy, dest, length * svga_scale * sizeof(Uint32));
+    }
+}
+
+// CE: Extends area to upload with given texture pixels (inclusive).
+static void svga_update_extend(int left, int top, int right, int bottom)
+{
+    if (svga_update_valid) {
+        svga_update_rect.ulx = std::min(svga_update_rect.ulx, left);
+        svga_update_rect.uly = std::min(svga_update_rect.uly, top);
+        svga_update_rect.lrx = std::max(svga_update_rect.lrx, right);
+        svga_update_rect.lry = std::max(svga_update_rect.lry, bottom);
+    } else {
+        svga_update_rect.ulx = left;
+        svga_update_rect.uly = top;
+        svga_update_rect.lrx = right;
+        svga_update_rect.lry = bottom;
+        svga_update_valid = true;
+    }
+}
+
+// CE: Extends color cycling span of row `y` with pixels in `[start, end)`.
+static void svga_cycle_scan(int y, int start, int end)
+{
+    unsigned char* row = (unsigned char*)gSdlSurface->pixels + gSdlSurface->pitch * y;
+
+    int first = start;
+    while (first < end && (unsigned char)(row[first] - SVGA_CYCLE_FIRST) > SVGA_CYCLE_LAST - SVGA_CYCLE_FIRST) {
+        first++;
+    }
+
+    if (first == end) {
+        return;
+    }
+
+    int last = end - 1;
+    while ((unsigned char)(row[last] - SVGA_CYCLE_FIRST) > SVGA_CYCLE_LAST - SVGA_CYCLE_FIRST) {
+        last--;
+    }
+
+    if (first < svga_cycle_min[y]) {
+        svga_cycle_min[y] = first;
+    }
+
+    if (last > svga_cycle_max[y]) {
+        svga_cycle_max[y] = last;
+    }
+}
+
+// CE: Converts row of palette indices to texture format writing every pixel
+// `repeat` times.
+static void svga_expand_row(const unsigned char* src, int width, Uint32* dest, int repeat)
+{
+    int x = 0;
+
+    switch (repeat) {
+    case 1:
+        for (; x < width; x++) {
+            dest[x] = svga_palette[src[x]];
+        }
+        break;
+    case 2:
+#if defined(__SSE2__)
+        for (; x + 4 <= width; x += 4) {
+            __m128i colors = _mm_set_epi32(svga_palette[src[x + 3]], svga_palette[src[x + 2]], svga_palette[src[x + 1]], svga_palette[src[x]]);
+            _mm_storeu_si128((__m128i*)(dest + x * 2), _mm_unpacklo_epi32(colors, colors));
+            _mm_storeu_si128((__m128i*)(dest + x * 2 + 4), _mm_unpackhi_epi32(colors, colors));
+        }
+#endif
+        for (; x < width; x++) {
+            Uint32 color = svga_palette[src[x]];
+            dest[x * 2] = color;
+            dest[x * 2 + 1] = color;
+        }
+        break;
+    case 3:
+        for (; x < width; x++) {
+            Uint32 color = svga_palette[src[x]];
+            dest[x * 3] = color;
+            dest[x * 3 + 1] = color;
+            dest[x * 3 + 2] = color;
+        }
+        break;
+    default:
+        for (; x < width; x++) {
+            Uint32 color = svga_palette[src[x]];
+            for (int index = 0; index < repeat; index++) {
+                *dest++ = color;
+            }
+        }
+        break;
+    }
+}
+
+// CE: Scale2x (aka EPX) for pixels `[start, end)` of one row of palette
+// indices. Produces two output rows of `width * 2` pixels (only
+// `[start * 2, end * 2)` are written). Rows outside of frame should be passed
+// as duplicates of `row`.
+//
+//   B        E0 E1
+// D E F  ->  E2 E3
+//   H
+static void svga_scale2x_row(const unsigned char* above, const unsigned char* row, const unsigned char* below, int width, unsigned char* dest0, unsigned char* dest1, int start, int end)
+{
+    int x = start;
+
+#if defined(__SSE2__)
+    // Leftmost and rightmost pixels need clamped neighbours, they are handled
+    // by scalar code.
+    if (end - start > 17) {
+        if (x == 0) {
+            svga_scale2x_span(above, row, below, width, dest0, dest1, 0, 1);
+            x = 1;
+        }
+
+        for (; x + 16 <= end && x + 16 < width; x += 16) {
+            __m128i b = _mm_loadu_si128((const __m128i*)(above + x));
+            __m128i h = _mm_loadu_si128((const __m128i*)(below + x));
+            __m128i d = _mm_loadu_si128((const __m128i*)(row + x - 1));
+            __m128i e = _mm_loadu_si128((const __m128i*)(row + x));
+            __m128i f = _mm_loadu_si128((const __m128i*)(row + x + 1));
+
+            // B != H && D != F
+            __m128i cond = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(b, h), _mm_cmpeq_epi8(d, f)), _mm_set1_epi8(-1));
+
+            __m128i m0 = _mm_and_si128(cond, _mm_cmpeq_epi8(d, b));
+            __m128i m1 = _mm_and_si128(cond, _mm_cmpeq_epi8(b, f));
+            __m128i m2 = _mm_and_si128(cond, _mm_cmpeq_epi8(d, h));
+            __m128i m3 = _mm_and_si128(cond, _mm_cmpeq_epi8(h, f));
+
+            __m128i e0 = _mm_or_si128(_mm_and_si128(m0, d), _mm_andnot_si128(m0, e));
+            __m128i e1 = _mm_or_si128(_mm_and_si128(m1, f), _mm_andnot_si128(m1, e));
+            __m128i e2 = _mm_or_si128(_mm_and_si128(m2, d), _mm_andnot_si128(m2, e));
+            __m128i e3 = _mm_or_si128(_mm_and_si128(m3, f), _mm_andnot_si128(m3, e));
+
+            _mm_storeu_si128((__m128i*)(dest0 + x * 2), _mm_unpacklo_epi8(e0, e1));
+            _mm_storeu_si128((__m128i*)(dest0 + x * 2 + 16), _mm_unpackhi_epi8(e0, e1));
+            _mm_storeu_si128((__m128i*)(dest1 + x * 2), _mm_unpacklo_epi8(e2, e3));
+            _mm_storeu_si128((__m128i*)(dest1 + x * 2 + 16), _mm_unpackhi_epi8(e2, e3));
+        }
+
+    }
+#endif
+
+    svga_scale2x_span(above, row, below, width, dest0, dest1, x, end);
+}
+
+// CE: Scalar Scale2x for pixels in `[start, end)` of the row.
+static void svga_scale2x_span(const unsigned char* above, const unsigned char* row, const unsigned char* below, int width, unsigned char* dest0, unsigned char* dest1, int start, int end)
+{
+    for (int x = start; x < end; x++) {
+        unsigned char b = above[x];
+        unsigned char h = below[x];
+        unsigned char d = row[x > 0 ? x - 1 : x];
+        unsigned char e = row[x];
+        unsigned char f = row[x < width - 1 ? x + 1 : x];
+
+        if (b != h && d != f) {
+            dest0[x * 2] = d == b ? d : e;
+            dest0[x * 2 + 1] = b == f ? f : e;
+            dest1[x * 2] = d == h ? d : e;
+            dest1[x * 2 + 1] = h == f ? f : e;
+        } else {
+            dest0[x * 2] = e;
+            dest0[x * 2 + 1] = e;
+            dest1[x * 2] = e;
+            dest1[x * 2 + 1] = e;
+        }
+    }
+}
+
+// CE: Hashes (FNV-1a, 64-bit) visible indexed pixels and active palette of
+// the frame about to be presented, and/or saves it as BMP. Hashes are stable
+// across backends, so headless runs can be compared against reference logs.
+static void frame_capture(SDL_Surface* surface)
+{
+    SDL_Palette* sdlPalette = surface->format->palette;
+
+    unsigned char palette[256 * 3];
+    memset(palette, 0, sizeof(palette));
+
+    if (sdlPalette != NULL) {
+        int count = sdlPalette->ncolors < 256 ? sdlPalette->ncolors : 256;
+        for (int index = 0; index < count; index++) {
+            palette[index * 3 + 0] = sdlPalette->colors[index].r >> 2;
+            palette[index * 3 + 1] = sdlPalette->colors[index].g >> 2;
+            palette[index * 3 + 2] = sdlPalette->colors[index].b >> 2;
+        }
+    }
+
+    if (svga_frame_hash) {
+        unsigned long long hash = 14695981039346656037ULL;
+
+        for (int y = 0; y < surface->h; y++) {
+            unsigned char* row = (unsigned char*)surface->pixels + surface->pitch * y;
+            for (int x = 0; x < surface->w; x++) {
+                hash ^= row[x];
+                hash *= 1099511628211ULL;
+            }
+        }
+
+        for (int index = 0; index < 256 * 3; index++) {
+            hash ^= palette[index];
+            hash *= 1099511628211ULL;
+        }
+
+        debug_printf("frame %u hash %016llx\n", svga_frame_count, hash);
+    }
+
+    if (svga_frame_dump) {
+        // Surface pitch can be wider than its width, BMP writer expects
+        // tightly packed rows.
+        unsigned char* data = (unsigned char*)mem_malloc(surface->w * surface->h);
+        if (data != NULL) {
+            for (int y = 0; y < surface->h; y++) {
+                memcpy(data + surface->w * y, (unsigned char*)surface->pixels + surface->pitch * y, surface->w);
+            }
+
+            char fileName[16];
+            snprintf(fileName, sizeof(fileName), "frm%.5u.bmp", svga_frame_count % 100000);
+            save_bmp(fileName, surface->w, surface->h, data, palette);
+
+            mem_free(data);
+        }
+    }
+}
+
 
 
 
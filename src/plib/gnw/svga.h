@@ -21,6 +21,7 @@ extern FpsLimiter sharedFpsLimiter;
 
 void GNW95_SetPaletteEntries(unsigned char* a1, int a2, int a3);
 void GNW95_SetPalette(unsigned char* palette);
+void svga_mark_dirty(int x, int y, int width, int height);
 void GNW95_ShowRect(unsigned char* src, unsigned int src_pitch, unsigned int a3, unsigned int src_x, unsigned int src_y, unsigned int src_width, unsigned int src_height, unsigned int dest_x, unsigned int dest_y);
 
 bool svga_init(VideoOptions* video_options);
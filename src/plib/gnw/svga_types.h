@@ -14,11 +14,33 @@ typedef int(SetModeFunc)();
 typedef void(ScreenTransBlitFunc)(unsigned char* srcBuf, unsigned int srcW, unsigned int srcH, unsigned int subX, unsigned int subY, unsigned int subW, unsigned int subH, unsigned int dstX, unsigned int dstY, unsigned char trans);
 typedef void(ScreenBlitFunc)(unsigned char* srcBuf, unsigned int srcW, unsigned int srcH, unsigned int subX, unsigned int subY, unsigned int subW, unsigned int subH, unsigned int dstX, unsigned int dstY);
 
+// CE: Upscaling filters (see `VideoOptions::scaleFilter`).
+typedef enum ScaleFilter {
+    SCALE_FILTER_NEAREST,
+    SCALE_FILTER_SCALE2X,
+} ScaleFilter;
+
 typedef struct VideoOptions {
     int width;
     int height;
     bool fullscreen;
     int scale;
+
+    // CE: Filter used to upscale frame when `scale` is greater than 1.
+    // Scale2x is only available for `scale` 2, other scales always use
+    // nearest neighbour.
+    int scaleFilter;
+
+    // CE: Null video backend - renders into in-memory surface only, no
+    // window/renderer/texture is created.
+    bool headless;
+
+    // CE: Log FNV-1a hash of every presented frame (indexed pixels and
+    // palette).
+    bool frameHash;
+
+    // CE: Save every presented frame as `frmNNNNN.bmp`.
+    bool frameDump;
 } VideoOptions;
 
 } // namespace fallout